@@ -44,7 +44,12 @@ const char* filters[] = { "dilate", "erode", "lcc", "median", NULL };
 const OptionGroup DilateErodeOption = OptionGroup ("Options for dilate / erode filters")
 
   + Option ("npass", "the number of times to repeatedly apply the filter")
-    + Argument ("value").type_integer (1, 1, 1e6);
+    + Argument ("value").type_integer (1, 1, 1e6)
+
+  + Option ("radius", "dilate / erode the mask by a physical distance in mm, based on the Euclidean "
+                      "distance to the nearest voxel inside / outside the mask, rather than by repeated "
+                      "application of the filter (cannot be combined with -npass)")
+    + Argument ("value").type_float (0.0, 1.0, 1e6);
 
 
 
@@ -74,6 +79,12 @@ Image::Filter::Base* create_dilate_filter (Image::BufferPreload<bool>::voxel_typ
   Options opt = get_options ("npass");
   if (opt.size())
     filter->set_npass (int(opt[0][0]));
+  Options opt_radius = get_options ("radius");
+  if (opt_radius.size()) {
+    if (opt.size())
+      throw Exception ("Options -npass and -radius are mutually exclusive");
+    filter->set_radius (opt_radius[0][0]);
+  }
   return filter;
 }
 
@@ -83,6 +94,12 @@ Image::Filter::Base* create_erode_filter (Image::BufferPreload<bool>::voxel_type
   Options opt = get_options ("npass");
   if (opt.size())
     filter->set_npass (int(opt[0][0]));
+  Options opt_radius = get_options ("radius");
+  if (opt_radius.size()) {
+    if (opt.size())
+      throw Exception ("Options -npass and -radius are mutually exclusive");
+    filter->set_radius (opt_radius[0][0]);
+  }
   return filter;
 }
 
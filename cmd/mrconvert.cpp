@@ -29,6 +29,7 @@
 #include "image/adapter/extract.h"
 #include "image/adapter/permute_axes.h"
 #include "image/stride.h"
+#include "image/stream.h"
 #include "dwi/gradient.h"
 
 
@@ -163,8 +164,26 @@ class zero_non_finite {
       }
 };
 
+// copy one slice at a time along the outermost axis, so that piped images
+// can be streamed from / to adjacent commands in a pipeline
+template <class InputVoxelType, class OutputVoxelType>
+inline void streamed_copy (InputVoxelType& in, OutputVoxelType& out, const Image::Header* streamed_input, const Image::Header& header_out)
+{
+  const size_t axis = out.ndim() - 1;
+  ProgressBar progress ("copying from \"" + shorten (in.name()) + "\" to \"" + shorten (out.name()) + "\"...", out.dim (axis));
+  for (in[axis] = out[axis] = 0; out[axis] < out.dim (axis); ++in[axis], ++out[axis]) {
+    if (streamed_input)
+      Image::Stream::wait_for (*streamed_input, in[axis] + 1);
+    Image::threaded_copy (in, out, 2, 0, axis);
+    Image::Stream::publish (header_out, out[axis] + 1);
+    ++progress;
+  }
+}
+
+
+
   template <class InputVoxelType>
-inline void copy_permute (InputVoxelType& in, Image::Header& header_out, const std::string& output_filename)
+inline void copy_permute (InputVoxelType& in, Image::Header& header_out, const std::string& output_filename, const Image::Header* streamed_input = NULL)
 {
   bool replace_nans = App::get_options ("zero").size();
 
@@ -187,6 +206,8 @@ inline void copy_permute (InputVoxelType& in, Image::Header& header_out, const s
     if (replace_nans)
       Image::ThreadedLoop ("copying from \"" + shorten (in.name()) + "\" to \"" + shorten (out.name()) + "\"...", in, 2)
         .run (zero_non_finite(), in, out);
+    else if (streamed_input || Image::Stream::is_streamed (buffer_out))
+      streamed_copy (in, out, streamed_input, buffer_out);
     else
       Image::threaded_copy_with_progress (in, out, 2);
   }
@@ -204,6 +225,7 @@ inline void copy_permute (InputVoxelType& in, Image::Header& header_out, const s
 void run ()
 {
   Image::Header header_in (argument[0]);
+  const bool streamed_input = Image::Stream::open_input (header_in);
 
   Image::Buffer<complex_type> buffer_in (header_in);
   auto in = buffer_in.voxel();
@@ -245,11 +267,16 @@ void run ()
       }
     }
 
+    if (streamed_input)
+      Image::Stream::wait_for (buffer_in, std::numeric_limits<size_t>::max());
     Image::Adapter::Extract<decltype(in)> extract (in, pos);
     copy_permute (extract, header_out, argument[1]);
   }
-  else
-    copy_permute (in, header_out, argument[1]);
+  else {
+    if (streamed_input && (get_options ("axes").size() || get_options ("zero").size()))
+      Image::Stream::wait_for (buffer_in, std::numeric_limits<size_t>::max());
+    copy_permute (in, header_out, argument[1], streamed_input ? &buffer_in : NULL);
+  }
 
 }
 
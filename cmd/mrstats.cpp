@@ -20,6 +20,7 @@
 
 */
 
+#include <cstring>
 #include <iomanip>
 #include <vector>
 
@@ -30,6 +31,7 @@
 #include "image/voxel.h"
 #include "image/buffer.h"
 #include "image/loop.h"
+#include "image/threaded_loop.h"
 #include "math/median.h"
 
 
@@ -112,17 +114,45 @@ class CalibrateHistogram
 
 
 
+// For exact computation of the median without storing all values, each value is
+//   mapped to an unsigned integer key that preserves its ordering; a histogram of the
+//   upper 16 bits of these keys is built alongside the other statistics, and a second
+//   pass then builds a histogram of the lower 16 bits of those values within the one
+//   or two upper bins in which the median lies.
+inline uint32_t sort_key (value_type value)
+{
+  if (value == 0.0)
+    value = 0.0; // -0.0 and +0.0 compare equal
+  uint32_t key;
+  memcpy (&key, &value, sizeof (key));
+  return (key & 0x80000000U) ? ~key : (key | 0x80000000U);
+}
+
+inline value_type from_sort_key (uint32_t key)
+{
+  key = (key & 0x80000000U) ? (key & 0x7FFFFFFFU) : ~key;
+  value_type value;
+  memcpy (&value, &key, sizeof (value));
+  return value;
+}
+
+
+
 class Stats
 {
   public:
-    Stats (bool is_complex = false) :
+    Stats (bool is_complex = false, bool median_by_histogram = false) :
       mean (0.0, 0.0),
-      std (0.0, 0.0),
+      m2 (0.0, 0.0),
       min (INFINITY, INFINITY),
       max (-INFINITY, -INFINITY),
       count (0),
+      hmin (0.0),
+      hwidth (0.0),
       dump (NULL),
-      is_complex (is_complex) { }
+      is_complex (is_complex),
+      median (NAN),
+      key_hist (median_by_histogram && !is_complex ? 65536 : 0, 0) { }
 
     void generate_histogram (const CalibrateHistogram& cal) {
       hmin = cal.min;
@@ -143,18 +173,22 @@ class Stats
 
     void operator() (complex_type val) {
       if (std::isfinite (val.real()) && std::isfinite (val.imag())) {
-        mean += val;
-        std += cdouble (val.real()*val.real(), val.imag()*val.imag());
+        // Welford's running update of mean & sum of squared deviations, for real & imaginary parts
+        count++;
+        const cdouble delta (val.real() - mean.real(), val.imag() - mean.imag());
+        mean += delta / double (count);
+        m2 += cdouble (delta.real() * (val.real() - mean.real()), delta.imag() * (val.imag() - mean.imag()));
         if (min.real() > val.real()) min = complex_type (val.real(), min.imag());
         if (min.imag() > val.imag()) min = complex_type (min.real(), val.imag());
         if (max.real() < val.real()) max = complex_type (val.real(), max.imag());
         if (max.imag() < val.imag()) max = complex_type (max.real(), val.imag());
-        count++;
 
         if (dump)
           *dump << str(val) << "\n";
 
-        if (!is_complex)
+        if (key_hist.size())
+          ++key_hist[sort_key (val.real()) >> 16];
+        else if (!is_complex)
           values.push_back(val.real());
 
 
@@ -169,22 +203,114 @@ class Stats
       }
     }
 
-    template <class Set> void print (Set& ima, const std::vector<std::string>& fields) {
 
-      if (count) {
-        mean /= double (count);
-        std = complex_type (sqrt (std.real()/double(count) - mean.real()*mean.real()),
-            sqrt (std.imag()/double(count) - mean.imag()*mean.imag()));
+    // Combine the statistics of a disjoint set of values (Chan et al., 1979)
+    void merge (const Stats& that) {
+      if (!that.count)
+        return;
+      const size_t total = count + that.count;
+      const cdouble delta (that.mean - mean);
+      const double factor = double (count) * double (that.count) / double (total);
+      m2 += that.m2 + cdouble (Math::pow2 (delta.real()) * factor, Math::pow2 (delta.imag()) * factor);
+      mean += delta * (double (that.count) / double (total));
+      count = total;
+      min = complex_type (std::min (min.real(), that.min.real()), std::min (min.imag(), that.min.imag()));
+      max = complex_type (std::max (max.real(), that.max.real()), std::max (max.imag(), that.max.imag()));
+      for (size_t i = 0; i != hist.size(); ++i)
+        hist[i] += that.hist[i];
+      for (size_t i = 0; i != key_hist.size(); ++i)
+        key_hist[i] += that.key_hist[i];
+    }
+
+
+    // Second pass for the exact median: histogram the lower 16 bits of the keys of
+    //   those values within the upper bins of interest
+    class MedianRefinement {
+      public:
+        MedianRefinement (std::vector<size_t>& overall, const std::vector<uint32_t>& upper_bins) :
+          overall (overall), upper_bins (upper_bins), local (overall.size(), 0) { }
+        MedianRefinement (const MedianRefinement& that) :
+          overall (that.overall), upper_bins (that.upper_bins), local (overall.size(), 0) { }
+        ~MedianRefinement () {
+          for (size_t i = 0; i != local.size(); ++i)
+            overall[i] += local[i];
+        }
+
+        template <class VoxelType>
+          void operator() (VoxelType& vox) { add (complex_type (vox.value()).real()); }
+        template <class VoxelType, class MaskVoxelType>
+          void operator() (VoxelType& vox, MaskVoxelType& mask) { if (mask.value() > 0.5) add (complex_type (vox.value()).real()); }
+
+      private:
+        std::vector<size_t>& overall;
+        const std::vector<uint32_t>& upper_bins;
+        std::vector<size_t> local;
+
+        void add (const value_type val) {
+          if (!std::isfinite (val))
+            return;
+          const uint32_t key = sort_key (val);
+          for (size_t i = 0; i != upper_bins.size(); ++i) {
+            if ((key >> 16) == upper_bins[i]) {
+              ++local[(i << 16) | (key & 0xFFFFU)];
+              return;
+            }
+          }
+        }
+    };
+
+
+    // Compute the exact median from the key histogram, using a second pass over the data
+    //   (via functor refine, which will be passed a MedianRefinement object)
+    template <class Functor>
+      void compute_median (Functor&& refine) {
+        if (!count || key_hist.empty())
+          return;
+        // The median is the mean of the values with these ranks
+        const size_t ranks[2] = { (count - 1) / 2, count / 2 };
+        std::vector<uint32_t> upper_bins;
+        size_t below[2];
+        size_t rank_upper_bin[2];
+        for (size_t r = 0; r != 2; ++r) {
+          size_t cumulative = 0, bin = 0;
+          while (cumulative + key_hist[bin] <= ranks[r])
+            cumulative += key_hist[bin++];
+          below[r] = cumulative;
+          if (upper_bins.empty() || upper_bins.back() != bin)
+            upper_bins.push_back (bin);
+          rank_upper_bin[r] = upper_bins.size() - 1;
+        }
+
+        std::vector<size_t> lower_hist (upper_bins.size() << 16, 0);
+        refine (MedianRefinement (lower_hist, upper_bins));
+
+        value_type result[2];
+        for (size_t r = 0; r != 2; ++r) {
+          const size_t offset = rank_upper_bin[r] << 16;
+          size_t cumulative = below[r], bin = 0;
+          while (cumulative + lower_hist[offset + bin] <= ranks[r])
+            cumulative += lower_hist[offset + bin++];
+          result[r] = from_sort_key ((upper_bins[rank_upper_bin[r]] << 16) | bin);
+        }
+        median = (result[0] + result[1]) / 2.0;
       }
 
-      std::sort (values.begin(), values.end());
+
+    template <class Set> void print (Set& ima, const std::vector<std::string>& fields) {
+
+      complex_type std (NAN, NAN);
+      if (count)
+        std = complex_type (sqrt (m2.real() / double(count)), sqrt (m2.imag() / double(count)));
+
+      if (key_hist.empty())
+        median = Math::median (values);
 
       if (fields.size()) {
         if (!count) 
           return;
         for (size_t n = 0; n < fields.size(); ++n) {
           if (fields[n] == "mean") std::cout << str(mean) << " ";
-          else if (fields[n] == "median") std::cout << Math::median (values) << " ";
+          else if (fields[n] == "median") std::cout << median << " ";
           else if (fields[n] == "std") std::cout << str(std) << " ";
           else if (fields[n] == "min") std::cout << str(min) << " ";
           else if (fields[n] == "max") std::cout << str(max) << " ";
@@ -209,7 +335,7 @@ class Stats
         std::cout << std::setw(width) << std::right << ( count ? str(mean) : "N/A" );
 
         if (!is_complex) {
-          std::cout << " " << std::setw(width) << std::right << ( count ? str(Math::median (values)) : "N/A" );
+          std::cout << " " << std::setw(width) << std::right << ( count ? str(median) : "N/A" );
         }
         std::cout << " " << std::setw(width) << std::right << ( count > 1 ? str(std) : "N/A" )
           << " " << std::setw(width) << std::right << ( count ? str(min) : "N/A" )
@@ -220,14 +346,42 @@ class Stats
     }
 
   private:
-    cdouble mean, std;
+    cdouble mean, m2;
     complex_type min, max;
     size_t count;
     value_type hmin, hwidth;
     std::vector<size_t> hist;
     std::ostream* dump;
     bool is_complex;
+    value_type median;
     std::vector<float> values;
+    std::vector<size_t> key_hist;
+
+    friend class StatsAccumulator;
+};
+
+
+
+// Per-thread accumulation of statistics for use with Image::ThreadedLoop:
+//   each copy accumulates separately, and is merged into the overall statistics on destruction
+class StatsAccumulator {
+  public:
+    StatsAccumulator (Stats& overall) : overall (overall), local (overall.is_complex, overall.key_hist.size()) {
+      local.hmin = overall.hmin;
+      local.hwidth = overall.hwidth;
+      local.hist.assign (overall.hist.size(), 0);
+    }
+    StatsAccumulator (const StatsAccumulator& that) : StatsAccumulator (that.overall) { }
+    ~StatsAccumulator () { overall.merge (local); }
+
+    template <class VoxelType>
+      void operator() (VoxelType& vox) { local (vox.value()); }
+    template <class VoxelType, class MaskVoxelType>
+      void operator() (VoxelType& vox, MaskVoxelType& mask) { if (mask.value() > 0.5) local (vox.value()); }
+
+  private:
+    Stats& overall;
+    Stats local;
 };
 
 
@@ -286,6 +440,10 @@ void run () {
 
   Options voxels = get_options ("voxel");
 
+  // Statistics over the whole image or a mask are accumulated in parallel, unless the
+  //   values or positions must be written out in order
+  const bool parallel = !dumpstream && !position_stream;
+
   opt = get_options ("mask");
   if (opt.size()) { // within mask:
 
@@ -309,7 +467,7 @@ void run () {
     }
 
     for (auto i = outer_loop (vox); i; ++i) {
-      Stats stats (vox.datatype().is_complex());
+      Stats stats (vox.datatype().is_complex(), parallel);
 
       if (dumpstream)
         stats.dump_to (*dumpstream);
@@ -317,13 +475,19 @@ void run () {
       if (hist_stream)
         stats.generate_histogram (calibrate);
 
-      for (auto j = inner_loop (mask, vox); j; ++j) {
-        if (mask.value() > 0.5) {
-          stats (vox.value());
-          if (position_stream) {
-            for (size_t i = 0; i < vox.ndim(); ++i)
-              *position_stream << vox[i] << " ";
-            *position_stream << "\n";
+      if (parallel) {
+        Image::ThreadedLoop loop (vox, 0, 3);
+        loop.run (StatsAccumulator (stats), vox, mask);
+        stats.compute_median ([&] (Stats::MedianRefinement&& refine) { loop.run (refine, vox, mask); });
+      } else {
+        for (auto j = inner_loop (mask, vox); j; ++j) {
+          if (mask.value() > 0.5) {
+            stats (vox.value());
+            if (position_stream) {
+              for (size_t i = 0; i < vox.ndim(); ++i)
+                *position_stream << vox[i] << " ";
+              *position_stream << "\n";
+            }
           }
         }
       }
@@ -358,7 +522,7 @@ void run () {
     }
 
     for (auto l = outer_loop (vox); l; ++l) {
-      Stats stats (vox.datatype().is_complex());
+      Stats stats (vox.datatype().is_complex(), parallel);
 
       if (dumpstream)
         stats.dump_to (*dumpstream);
@@ -366,12 +530,18 @@ void run () {
       if (hist_stream)
         stats.generate_histogram (calibrate);
 
-      for (auto j = inner_loop (vox); j; ++j) {
-        stats (vox.value());
-        if (position_stream) {
-          for (size_t i = 0; i < vox.ndim(); ++i)
-            *position_stream << vox[i] << " ";
-          *position_stream << "\n";
+      if (parallel) {
+        Image::ThreadedLoop loop (vox, 0, 3);
+        loop.run (StatsAccumulator (stats), vox);
+        stats.compute_median ([&] (Stats::MedianRefinement&& refine) { loop.run (refine, vox); });
+      } else {
+        for (auto j = inner_loop (vox); j; ++j) {
+          stats (vox.value());
+          if (position_stream) {
+            for (size_t i = 0; i < vox.ndim(); ++i)
+              *position_stream << vox[i] << " ";
+            *position_stream << "\n";
+          }
         }
       }
 
@@ -20,13 +20,15 @@
 
 */
 
-#include <map>
+#include <cstring>
+#include <vector>
 
 #include "command.h"
 #include "progressbar.h"
 #include "image/buffer.h"
 #include "image/voxel.h"
 #include "image/loop.h"
+#include "image/threaded_loop.h"
 #include "image/histogram.h"
 #include "image/filter/optimal_threshold.h"
 
@@ -86,6 +88,73 @@ void usage ()
 }
 
 
+// Selection of the N top- or bottom-valued voxels is performed on an unsigned
+//   integer key that preserves the ordering of the floating-point values: the
+//   exact cutoff is found from a histogram of the upper 16 bits of the key of
+//   every voxel, then a histogram of the lower 16 bits of those voxels within
+//   the selected upper bin. Each histogram is accumulated in parallel, with
+//   memory usage independent of image size.
+inline uint32_t sort_key (float value)
+{
+  if (value == 0.0)
+    value = 0.0; // -0.0 and +0.0 compare equal
+  uint32_t key;
+  memcpy (&key, &value, sizeof (key));
+  return (key & 0x80000000U) ? ~key : (key | 0x80000000U);
+}
+
+typedef std::vector<size_t> KeyHistogram;
+
+class KeyHistogramFunctor {
+  public:
+    // Histogram the upper 16 bits of the key of every value if upper_bin is negative;
+    //   otherwise the lower 16 bits of those with upper 16 bits equal to upper_bin
+    KeyHistogramFunctor (KeyHistogram& overall, const bool ignore_zeroes, const int upper_bin = -1) :
+      overall (overall), ignore_zeroes (ignore_zeroes), upper_bin (upper_bin), local (overall.size(), 0) { }
+
+    ~KeyHistogramFunctor () {
+      for (size_t i = 0; i != local.size(); ++i)
+        overall[i] += local[i];
+    }
+
+    template <class VoxelType>
+      void operator() (VoxelType& vox) {
+        const float val = vox.value();
+        if (!std::isfinite (val) || (ignore_zeroes && val == 0.0))
+          return;
+        const uint32_t key = sort_key (val);
+        if (upper_bin < 0)
+          ++local[key >> 16];
+        else if (int (key >> 16) == upper_bin)
+          ++local[key & 0xFFFFU];
+      }
+
+  private:
+    KeyHistogram& overall;
+    const bool ignore_zeroes;
+    const int upper_bin;
+    KeyHistogram local;
+};
+
+
+// Walk the histogram from the top (or bottom) until at least N values have been
+//   accumulated; returns the bin at which this occurs, and the number of values
+//   in bins strictly beyond it
+size_t select_bin (const KeyHistogram& hist, const size_t N, const bool top, size_t& beyond)
+{
+  beyond = 0;
+  for (size_t i = 0; i != hist.size(); ++i) {
+    const size_t bin = top ? hist.size() - 1 - i : i;
+    if (beyond + hist[bin] >= N)
+      return bin;
+    beyond += hist[bin];
+  }
+  assert (0);
+  return 0;
+}
+
+
+
 void run ()
 {
   float threshold_value (NAN), percentile (NAN), bottomNpercent (NAN), topNpercent (NAN);
@@ -187,57 +256,67 @@ void run ()
 
 
   if (topN || bottomN) {
-    std::multimap<float,std::vector<ssize_t> > list;
 
-    {
-      Image::Loop loop ("thresholding \"" + shorten (in.name()) + "\" at " + (
+    const bool top = topN;
+    const size_t N = top ? topN : bottomN;
+    const std::string msg ("thresholding \"" + shorten (in.name()) + "\" at " + (
                             std::isnan (percentile) ?
-                            (str (topN ? topN : bottomN) + "th " + (topN ? "top" : "bottom") + " voxel") :
+                            (str (N) + "th " + (top ? "top" : "bottom") + " voxel") :
                               (str (percentile*100.0) + "\% percentile")
                             ) + "...");
-
-      if (topN) {
-        for (auto l = loop (in); l; ++l) {
-          const float val = in.value();
-          if (!std::isfinite (val)) continue;
-          if (ignore_zeroes && val == 0.0) continue;
-          if (list.size() == topN) {
-            if (val < list.begin()->first) continue;
-            list.erase (list.begin());
-          }
-          std::vector<ssize_t> pos (in.ndim());
-          for (size_t n = 0; n < in.ndim(); ++n)
-            pos[n] = in[n];
-          list.insert (std::pair<float,std::vector<ssize_t> > (val, pos));
-        }
-      }
-      else {
-        for (auto l = loop (in); l; ++l) {
-          const float val = in.value();
-          if (!std::isfinite (val)) continue;
-          if (ignore_zeroes && val == 0.0) continue;
-          if (list.size() == bottomN) {
-            std::multimap<float,std::vector<ssize_t> >::iterator i = list.end();
-            --i;
-            if (val > i->first) continue;
-            list.erase (i);
-          }
-          std::vector<ssize_t> pos (in.ndim());
-          for (size_t n = 0; n < in.ndim(); ++n)
-            pos[n] = in[n];
-          list.insert (std::pair<float,std::vector<ssize_t> > (val, pos));
+    ProgressBar progress (msg, 3);
+
+    KeyHistogram upper (65536, 0);
+    Image::ThreadedLoop (in).run (KeyHistogramFunctor (upper, ignore_zeroes), in);
+    ++progress;
+
+    size_t total = 0;
+    for (size_t i = 0; i != upper.size(); ++i)
+      total += upper[i];
+
+    // Cutoff key, and the number of voxels with that exact key to be included
+    uint32_t cutoff = top ? 0 : std::numeric_limits<uint32_t>::max();
+    size_t ties_required = 0, ties_total = 0;
+    if (N < total) {
+      size_t beyond_upper, beyond_lower;
+      const size_t upper_bin = select_bin (upper, N, top, beyond_upper);
+      KeyHistogram lower (65536, 0);
+      Image::ThreadedLoop (in).run (KeyHistogramFunctor (lower, ignore_zeroes, upper_bin), in);
+      const size_t lower_bin = select_bin (lower, N - beyond_upper, top, beyond_lower);
+      cutoff = (upper_bin << 16) | lower_bin;
+      ties_required = N - beyond_upper - beyond_lower;
+      ties_total = lower[lower_bin];
+    }
+    ++progress;
+
+    // Voxels with a key beyond the cutoff are always selected; if only some of
+    //   those with a key equal to the cutoff are to be selected, the later voxels
+    //   in the image are preferred for top-N and the earlier for bottom-N
+    auto selected = [&] (const float val) {
+      if (!std::isfinite (val) || (ignore_zeroes && val == 0.0))
+        return false;
+      const uint32_t key = sort_key (val);
+      return top ? (key >= cutoff) : (key <= cutoff);
+    };
+
+    if (ties_required == ties_total) {
+      Image::ThreadedLoop (in).run ([&] (decltype(in)& vin, decltype(out)& vout) {
+          vout.value() = selected (vin.value()) ? one : zero;
+        }, in, out);
+    } else {
+      size_t ties_seen = 0;
+      for (auto l = Image::Loop() (in, out); l; ++l) {
+        const float val = in.value();
+        bool select = selected (val);
+        if (select && sort_key (val) == cutoff) {
+          select = top ? (ties_seen >= ties_total - ties_required) : (ties_seen < ties_required);
+          ++ties_seen;
         }
+        out.value() = select ? one : zero;
       }
     }
+    ++progress;
 
-    for (auto l = Image::Loop() (out); l; ++l) 
-      out.value() = zero;
-
-    for (std::multimap<float,std::vector<ssize_t> >::const_iterator i = list.begin(); i != list.end(); ++i) {
-      for (size_t n = 0; n < out.ndim(); ++n)
-        out[n] = i->second[n];
-      out.value() = one;
-    }
   }
   else {
     if (use_histogram) {
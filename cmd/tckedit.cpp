@@ -72,6 +72,11 @@ void usage ()
   + Option ("inverse", "output the inverse selection of streamlines based on the criteria provided, "
                        "i.e. only those streamlines that fail at least one criterion will be written to file.")
 
+  + Option ("index", "use a spatial index of each input track file to avoid reading streamlines that "
+                     "cannot intersect the include / mask ROIs. The index is stored alongside each "
+                     "track file (with the suffix .idx) on first use, and reused thereafter. "
+                     "Not compatible with -inverse or -tck_weights_in.")
+
   // TODO Input weights with multiple input files currently not supported
   + Tractography::TrackWeightsInOption
   + Tractography::TrackWeightsOutOption;
@@ -180,7 +185,13 @@ void run ()
   opt = get_options ("skip");
   const size_t skip   = opt.size() ? size_t(opt[0][0]) : 0;
 
-  Loader loader (input_file_list);
+  const bool use_index = get_options ("index").size();
+  if (use_index && inverse)
+    throw Exception ("Option -index cannot be used in conjunction with -inverse");
+  if (use_index && get_options ("tck_weights_in").size())
+    throw Exception ("Option -index cannot be used in conjunction with -tck_weights_in");
+
+  Loader loader (input_file_list, use_index ? &properties : NULL);
   Worker worker (properties, upsample, downsample, inverse);
   // This needs to be run AFTER creation of the Worker class
   // (worker needs to be able to set max & min number of points based on step size in input file,
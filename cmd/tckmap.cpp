@@ -148,6 +148,11 @@ const OptionGroup MappingOption = OptionGroup ("Options for the streamline-to-vo
       "use a more precise streamline mapping strategy, that accurately quantifies the length through each voxel "
       "(these lengths are then taken into account during TWI calculation)")
 
+  + Option ("exact",
+      "quantify the length through each voxel exactly, by traversing the voxel grid along each streamline segment "
+      "rather than relying on streamline upsampling; this is typically both faster and more accurate than -precise "
+      "(not supported by the Gaussian track statistic, for which -precise mapping is used instead)")
+
   + Option ("ends_only",
       "only map the streamline endpoints to the image");
 
@@ -159,10 +164,32 @@ const OptionGroup ExtraOption = OptionGroup ("Additional options for tckmap")
       "dump the scratch buffer contents directly to a .mih / .dat file pair or .mif file, "
       "rather than memory-mapping the output file (this is useful if either the image is "
       "larger than half the available RAM, or a network file system is in use where writing "
-      "to a memory-mapped output file performs very poorly)");
+      "to a memory-mapped output file performs very poorly)")
+
+  + Option ("per_thread_buffers",
+      "accumulate the mapped streamlines into a separate buffer for each thread, which are reduced "
+      "into the output image once all streamlines have been mapped; this avoids a single thread "
+      "writing to the output image becoming the bottleneck, at the expense of one additional copy "
+      "of the image in RAM per thread");
+
+
+
 
 
 
+// Runs the mapping of streamlines to voxels, either with a single thread updating the
+//   output buffer directly, or with one thread-private accumulation buffer per thread
+template <class Mapper, class SetType>
+void run_mapping (TrackLoader& loader, Mapper& mapper, const SetType& set_type, MapWriterBase& writer, const bool per_thread)
+{
+  if (per_thread) {
+    MapWriterBase::Shard shard (writer.shard());
+    Thread::run_queue (loader, Tractography::Streamline<float>(), Thread::multi (mapper), set_type, Thread::multi (shard));
+  } else {
+    Thread::run_queue (loader, Tractography::Streamline<float>(), Thread::multi (mapper), set_type, writer);
+  }
+}
+
 
 
 
@@ -473,12 +500,18 @@ void run () {
 
 
   // Figure out how the streamlines will be mapped
-  const bool precise = get_options ("precise").size();
+  const bool exact = get_options ("exact").size();
+  if (exact && get_options ("precise").size())
+    throw Exception ("Options -precise and -exact are mutually exclusive");
+  if (exact && stat_tck == GAUSSIAN)
+    WARN ("Exact mapping not supported for Gaussian track statistic; precise mapping will be used instead");
+  // Exact mapping provides the same per-voxel lengths as precise mapping
+  const bool precise = exact || get_options ("precise").size();
   header["precise_mapping"] = precise ? "1" : "0";
   const bool ends_only = get_options ("ends_only").size();
   if (ends_only) {
     if (precise)
-      throw Exception ("Options -precise and -ends_only are mutually exclusive");
+      throw Exception ("Options -" + str(exact ? "exact" : "precise") + " and -ends_only are mutually exclusive");
     header["endpoints_only"] = "1";
   }
 
@@ -491,6 +524,9 @@ void run () {
       upsample_ratio = opt[0][0];
       INFO ("track upsampling ratio manually set to " + str(upsample_ratio));
     }
+  } else if (exact && stat_tck != GAUSSIAN) {
+    // Exact mapping does not depend on upsampling for the voxel lengths
+    upsample_ratio = 1;
   } else if (!ends_only) {
     // If accurately calculating the length through each voxel traversed, need a higher upsampling ratio
     //   (1/10th of the voxel size was found to give a good quantification of chordal length)
@@ -593,6 +629,7 @@ void run () {
   mapper->set_upsample_ratio      (upsample_ratio);
   mapper->set_map_zero            (map_zero);
   mapper->set_use_precise_mapping (precise);
+  mapper->set_use_exact_mapping   (exact && stat_tck != GAUSSIAN);
   mapper->set_map_ends_only       (ends_only);
   if (writer_type == DIXEL)
     mapper->create_dixel_plugin (*dirs);
@@ -625,6 +662,7 @@ void run () {
   }
 
   writer->set_direct_dump (dump);
+  const bool per_thread = get_options ("per_thread_buffers").size();
 
   // Finally get to do some number crunching!
   // Complete branch here for Gaussian track-wise statistic; it's a nightmare to manage, so am
@@ -634,18 +672,18 @@ void run () {
     mapper_ptr->set_gaussian_FWHM (gaussian_fwhm_tck);
     switch (writer_type) {
       case UNDEFINED: throw Exception ("Invalid TWI writer image dimensionality");
-      case GREYSCALE: Thread::run_queue (loader, Tractography::Streamline<float>(), Thread::multi (*mapper_ptr), Gaussian::SetVoxel(),    *writer); break;
-      case DEC:       Thread::run_queue (loader, Tractography::Streamline<float>(), Thread::multi (*mapper_ptr), Gaussian::SetVoxelDEC(), *writer); break;
-      case DIXEL:     Thread::run_queue (loader, Tractography::Streamline<float>(), Thread::multi (*mapper_ptr), Gaussian::SetDixel(),    *writer); break;
-      case TOD:       Thread::run_queue (loader, Tractography::Streamline<float>(), Thread::multi (*mapper_ptr), Gaussian::SetVoxelTOD(), *writer); break;
+      case GREYSCALE: run_mapping (loader, *mapper_ptr, Gaussian::SetVoxel(),    *writer, per_thread); break;
+      case DEC:       run_mapping (loader, *mapper_ptr, Gaussian::SetVoxelDEC(), *writer, per_thread); break;
+      case DIXEL:     run_mapping (loader, *mapper_ptr, Gaussian::SetDixel(),    *writer, per_thread); break;
+      case TOD:       run_mapping (loader, *mapper_ptr, Gaussian::SetVoxelTOD(), *writer, per_thread); break;
     }
   } else {
     switch (writer_type) {
       case UNDEFINED: throw Exception ("Invalid TWI writer image dimensionality");
-      case GREYSCALE: Thread::run_queue (loader, Tractography::Streamline<float>(), Thread::multi (*mapper), SetVoxel(),    *writer); break;
-      case DEC:       Thread::run_queue (loader, Tractography::Streamline<float>(), Thread::multi (*mapper), SetVoxelDEC(), *writer); break;
-      case DIXEL:     Thread::run_queue (loader, Tractography::Streamline<float>(), Thread::multi (*mapper), SetDixel(),    *writer); break;
-      case TOD:       Thread::run_queue (loader, Tractography::Streamline<float>(), Thread::multi (*mapper), SetVoxelTOD(), *writer); break;
+      case GREYSCALE: run_mapping (loader, *mapper, SetVoxel(),    *writer, per_thread); break;
+      case DEC:       run_mapping (loader, *mapper, SetVoxelDEC(), *writer, per_thread); break;
+      case DIXEL:     run_mapping (loader, *mapper, SetDixel(),    *writer, per_thread); break;
+      case TOD:       run_mapping (loader, *mapper, SetVoxelTOD(), *writer, per_thread); break;
     }
   }
 
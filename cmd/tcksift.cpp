@@ -59,10 +59,12 @@ void usage ()
                "SIFT: Spherical-deconvolution informed filtering of tractograms. "
                "NeuroImage, 2013, 67, 298-312";
 
+  // the arguments are only optional so that they can be omitted with -benchmark_selection;
+  //   otherwise, all three are required (checked in run())
   ARGUMENTS
-  + Argument ("in_tracks",  "the input track file").type_file_in()
-  + Argument ("in_fod",     "input image containing the spherical harmonics of the fibre orientation distributions").type_image_in()
-  + Argument ("out_tracks", "the output filtered tracks file").type_file_out();
+  + Argument ("in_tracks",  "the input track file").type_file_in().optional()
+  + Argument ("in_fod",     "input image containing the spherical harmonics of the fibre orientation distributions").type_image_in().optional()
+  + Argument ("out_tracks", "the output filtered tracks file").type_file_out().optional();
 
   OPTIONS
 
@@ -79,7 +81,37 @@ void usage ()
   + Option ("out_selection", "output a text file containing the binary selection of streamlines")
     + Argument ("path").type_file_out()
 
-  + SIFTTermOption;
+  + Option ("incremental", "following each iteration, only re-calculate the cost function gradients of those streamlines "
+                           "traversing fixels modified by streamline removal; this reduces the computational cost of each "
+                           "iteration for large reconstructions, at the expense of additional RAM for a fixel-streamline index")
+
+  + OptionGroup ("Options for saving and re-using the SIFT model, and for checkpointing filtering")
+
+  + Option ("out_model", "save the SIFT model (FOD segmentation & streamline mapping) to a binary file prior to filtering, "
+                         "so that it can be re-used in subsequent runs with the -in_model option")
+    + Argument ("path").type_file_out()
+
+  + Option ("in_model", "load the SIFT model from a file previously generated using the -out_model option, rather than "
+                        "segmenting the FODs and mapping the streamlines; the input FOD image and track file must be those "
+                        "used to generate the model")
+    + Argument ("path").type_file_in()
+
+  + Option ("checkpoint", "write the state of the filtering process to a file at the end of every iteration, "
+                          "so that filtering can be resumed using the -resume option if interrupted")
+    + Argument ("path").type_file_out()
+
+  + Option ("resume", "resume filtering from a checkpoint file generated using the -checkpoint option "
+                      "(typically used in conjunction with -in_model)")
+    + Argument ("path").type_file_in()
+
+  + SIFTTermOption
+
+  + OptionGroup ("Debugging options")
+
+  + Option ("benchmark_selection", "compare the performance of the candidate streamline selection methods using a simulated "
+                                   "gradient vector of the specified size, then exit without processing any input data "
+                                   "(the input and output arguments can be omitted in this case)")
+    + Argument ("count").type_integer (1, 1000000, std::numeric_limits<int>::max());
 
 };
 
@@ -88,7 +120,16 @@ void usage ()
 void run ()
 {
 
-  Options opt = get_options ("output_debug");
+  Options opt = get_options ("benchmark_selection");
+  if (opt.size()) {
+    benchmark_candidate_selection (int(opt[0][0]));
+    return;
+  }
+
+  if (argument.size() != 3)
+    throw Exception ("expected exactly 3 arguments (" + str (argument.size()) + " supplied)");
+
+  opt = get_options ("output_debug");
   const bool out_debug = opt.size();
 
   Image::Buffer<float> in_dwi (argument[1]);
@@ -102,15 +143,28 @@ void run ()
       sifter.output_5tt_image ("5tt.mif");
   }
 
-  sifter.perform_FOD_segmentation (in_dwi);
-  sifter.scale_FDs_by_GM();
+  opt = get_options ("in_model");
+  if (opt.size()) {
+
+    sifter.load_model (opt[0][0], argument[0]);
 
-  sifter.map_streamlines (argument[0]);
+  } else {
 
-  if (out_debug)
-    sifter.output_all_debug_images ("before");
+    sifter.perform_FOD_segmentation (in_dwi);
+    sifter.scale_FDs_by_GM();
+
+    sifter.map_streamlines (argument[0]);
+
+    if (out_debug)
+      sifter.output_all_debug_images ("before");
 
-  sifter.remove_excluded_fixels ();
+    sifter.remove_excluded_fixels ();
+
+  }
+
+  opt = get_options ("out_model");
+  if (opt.size())
+    sifter.save_model (opt[0][0]);
 
   opt = get_options ("nofilter");
   if (!opt.size()) {
@@ -132,6 +186,13 @@ void run ()
       std::vector<int> counts = parse_ints (opt[0][0]);
       sifter.set_regular_outputs (counts, out_debug);
     }
+    sifter.set_incremental_gradients (get_options ("incremental").size());
+    opt = get_options ("checkpoint");
+    if (opt.size())
+      sifter.set_checkpoint_path (opt[0][0]);
+    opt = get_options ("resume");
+    if (opt.size())
+      sifter.load_checkpoint (opt[0][0]);
 
     sifter.perform_filtering();
 
@@ -74,9 +74,11 @@ namespace MR {
           }
 
           std::string tag_name () const {
-            if (dict.empty()) init_dict();
-            const char* s = dict[tag()];
-            return (s ? s : "");
+            // thread-safe: the dictionary is initialised once, and only queried thereafter
+            static const bool dict_initialised = (init_dict(), true);
+            (void) dict_initialised;
+            UnorderedMap<uint32_t, const char*>::Type::const_iterator s = dict.find (tag());
+            return (s == dict.end() || !s->second ? "" : s->second);
           }
 
           uint32_t tag () const {
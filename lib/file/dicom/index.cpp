@@ -0,0 +1,210 @@
+/*
+   Copyright 2014 Brain Research Institute, Melbourne, Australia
+
+   Written by J-Donald Tournier, 2014.
+
+   This file is part of MRtrix.
+
+   MRtrix is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   MRtrix is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with MRtrix.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include <fstream>
+#include <cstdio>
+
+#include "file/config.h"
+#include "file/path.h"
+#include "file/dicom/index.h"
+
+#define DICOM_INDEX_MAGIC "mrtrix DICOM index 1"
+#define DICOM_INDEX_NUM_FIELDS 21
+
+namespace MR {
+  namespace File {
+    namespace Dicom {
+
+      const char* Index::filename = ".mrtrix-dicom-index";
+
+
+
+      namespace {
+
+        // fields are tab-separated, one file per line: make sure the strings can't break this
+        inline std::string sanitise (std::string s)
+        {
+          for (std::string::iterator c = s.begin(); c != s.end(); ++c)
+            if (*c == '\t' || *c == '\n' || *c == '\r')
+              *c = ' ';
+          return s;
+        }
+
+      }
+
+
+
+      Index::Index (const std::string& folder) :
+        folder (folder),
+        path (Path::join (folder, filename)),
+        use_index (File::Config::get_bool ("DICOM.UseIndex", false)),
+        modified (false)
+      {
+        if (!use_index || !Path::exists (path))
+          return;
+
+        std::ifstream in (path.c_str());
+        std::string line;
+        if (!std::getline (in, line) || line != DICOM_INDEX_MAGIC) {
+          INFO ("ignoring invalid DICOM index file \"" + path + "\"");
+          return;
+        }
+
+        while (std::getline (in, line)) {
+          std::vector<std::string> V (split (line, "\t", false));
+          if (V.size() != 4 && V.size() != DICOM_INDEX_NUM_FIELDS) {
+            INFO ("ignoring malformed entry in DICOM index file \"" + path + "\"");
+            continue;
+          }
+          try {
+            Entry entry;
+            entry.size = to<int64_t> (V[1]);
+            entry.mtime = to<int64_t> (V[2]);
+            entry.is_image = to<int> (V[3]);
+            if (entry.is_image) {
+              if (V.size() != DICOM_INDEX_NUM_FIELDS)
+                throw Exception ("missing fields");
+              QuickScan& S (entry.scan);
+              S.filename = Path::join (folder, V[0]);
+              S.modality = V[4];
+              S.patient = V[5];
+              S.patient_ID = V[6];
+              S.patient_DOB = V[7];
+              S.study = V[8];
+              S.study_ID = V[9];
+              S.study_date = V[10];
+              S.study_time = V[11];
+              S.series = V[12];
+              S.series_date = V[13];
+              S.series_time = V[14];
+              S.sequence = V[15];
+              S.series_number = to<size_t> (V[16]);
+              S.bits_alloc = to<size_t> (V[17]);
+              S.dim[0] = to<size_t> (V[18]);
+              S.dim[1] = to<size_t> (V[19]);
+              S.data = to<size_t> (V[20]);
+            }
+            entries[V[0]] = entry;
+          }
+          catch (...) {
+            INFO ("ignoring malformed entry in DICOM index file \"" + path + "\"");
+          }
+        }
+
+        DEBUG ("read " + str (entries.size()) + " entries from DICOM index file \"" + path + "\"");
+      }
+
+
+
+
+      bool Index::find (const std::string& filename, int64_t size, time_t mtime, QuickScan& scan, bool& is_image) const
+      {
+        if (!use_index)
+          return false;
+        std::map<std::string, Entry>::const_iterator entry = entries.find (relative (filename));
+        if (entry == entries.end() || entry->second.size != size || entry->second.mtime != mtime)
+          return false;
+        is_image = entry->second.is_image;
+        if (is_image)
+          scan = entry->second.scan;
+        return true;
+      }
+
+
+
+
+      void Index::add (const std::string& filename, int64_t size, time_t mtime, const QuickScan& scan, bool is_image)
+      {
+        if (!use_index)
+          return;
+        Entry& entry (entries[relative (filename)]);
+        entry.size = size;
+        entry.mtime = mtime;
+        entry.is_image = is_image;
+        entry.scan = scan;
+        modified = true;
+      }
+
+
+
+
+      void Index::save ()
+      {
+        if (!use_index || !modified)
+          return;
+
+        // write to a temporary file and rename, so that concurrent scans never see a partial index
+        const std::string tmp_path (path + ".tmp");
+        {
+          std::ofstream out (tmp_path.c_str());
+          if (!out) {
+            INFO ("unable to write DICOM index file \"" + path + "\" - index not updated");
+            return;
+          }
+          out << DICOM_INDEX_MAGIC << "\n";
+          for (std::map<std::string, Entry>::const_iterator i = entries.begin(); i != entries.end(); ++i) {
+            const Entry& E (i->second);
+            out << sanitise (i->first) << "\t" << E.size << "\t" << int64_t (E.mtime) << "\t" << int (E.is_image);
+            if (E.is_image) {
+              const QuickScan& S (E.scan);
+              out << "\t" << sanitise (S.modality) << "\t" << sanitise (S.patient) << "\t" << sanitise (S.patient_ID)
+                << "\t" << sanitise (S.patient_DOB) << "\t" << sanitise (S.study) << "\t" << sanitise (S.study_ID)
+                << "\t" << sanitise (S.study_date) << "\t" << sanitise (S.study_time) << "\t" << sanitise (S.series)
+                << "\t" << sanitise (S.series_date) << "\t" << sanitise (S.series_time) << "\t" << sanitise (S.sequence)
+                << "\t" << S.series_number << "\t" << S.bits_alloc << "\t" << S.dim[0] << "\t" << S.dim[1] << "\t" << S.data;
+            }
+            out << "\n";
+          }
+          if (!out.good()) {
+            INFO ("error writing DICOM index file \"" + path + "\" - index not updated");
+            out.close();
+            std::remove (tmp_path.c_str());
+            return;
+          }
+        }
+
+        if (std::rename (tmp_path.c_str(), path.c_str())) {
+          INFO ("unable to write DICOM index file \"" + path + "\" - index not updated");
+          std::remove (tmp_path.c_str());
+          return;
+        }
+        modified = false;
+      }
+
+
+
+
+      std::string Index::relative (const std::string& filename) const
+      {
+        if (filename.compare (0, folder.size(), folder) == 0) {
+          size_t start = folder.size();
+          while (start < filename.size() && std::string (PATH_SEPARATOR).find (filename[start]) != std::string::npos)
+            ++start;
+          return filename.substr (start);
+        }
+        return filename;
+      }
+
+    }
+  }
+}
+
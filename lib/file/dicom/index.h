@@ -0,0 +1,82 @@
+/*
+   Copyright 2014 Brain Research Institute, Melbourne, Australia
+
+   Written by J-Donald Tournier, 2014.
+
+   This file is part of MRtrix.
+
+   MRtrix is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   MRtrix is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with MRtrix.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef __file_dicom_index_h__
+#define __file_dicom_index_h__
+
+#include <map>
+#include <sys/types.h>
+
+#include "file/dicom/quick_scan.h"
+
+namespace MR {
+  namespace File {
+    namespace Dicom {
+
+      //! A persistent index of the DICOM fields extracted from each file in a folder
+      /*! If the \c DICOM.UseIndex configuration option is set, the results of
+       * QuickScan for each file in a DICOM folder are stored in a hidden file in
+       * that folder, keyed on the file path, size and modification time. Files
+       * that have not changed since the last scan are then not read again. If
+       * the index cannot be written (e.g. read-only media), it is simply not
+       * used. */
+      class Index {
+        public:
+          Index (const std::string& folder);
+
+          bool enabled () const { return use_index; }
+
+          //! retrieve the scan for \a filename, if present and up to date
+          /*! \a is_image is set to false if the file was previously found not
+           * to contain DICOM image data. */
+          bool find (const std::string& filename, int64_t size, time_t mtime, QuickScan& scan, bool& is_image) const;
+
+          //! add or update the entry for \a filename
+          void add (const std::string& filename, int64_t size, time_t mtime, const QuickScan& scan, bool is_image);
+
+          //! write the index back to disk if it has been modified
+          void save ();
+
+          static const char* filename;
+
+        protected:
+          class Entry {
+            public:
+              int64_t size;
+              time_t mtime;
+              bool is_image;
+              QuickScan scan;
+          };
+
+          const std::string folder, path;
+          bool use_index, modified;
+          std::map<std::string, Entry> entries;
+
+          std::string relative (const std::string& filename) const;
+      };
+
+    }
+  }
+}
+
+#endif
+
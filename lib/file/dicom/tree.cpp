@@ -31,8 +31,12 @@
 */
 
 
+#include <sys/stat.h>
+
+#include "thread_queue.h"
 #include "file/path.h"
 #include "file/dicom/element.h"
+#include "file/dicom/index.h"
 #include "file/dicom/quick_scan.h"
 #include "file/dicom/image.h"
 #include "file/dicom/series.h"
@@ -71,23 +75,96 @@ namespace MR {
 
 
 
-      void Tree::read_dir (const std::string& filename, ProgressBar& progress)
+      namespace {
+
+        class ScanEntry {
+          public:
+            std::string filename;
+            int64_t size;
+            time_t mtime;
+            bool is_image;
+            QuickScan scan;
+        };
+
+        bool scan_file (const std::string& filename, QuickScan& reader)
+        {
+          try {
+            if (reader.read (filename)) {
+              INFO ("error reading file \"" + filename + "\" - assuming not DICOM"); 
+              return false;
+            }
+          }
+          catch (Exception& E) {
+            E.display (3);
+            return false;
+          }
+
+          if (! (reader.dim[0] && reader.dim[1] && reader.bits_alloc && reader.data)) {
+            INFO ("DICOM file \"" + filename + "\" does not seem to contain image data - ignored"); 
+            return false;
+          }
+          return true;
+        }
+
+
+        // Files are handed out by index, and the results stored in place, so that they
+        //   can subsequently be added to the tree in the order they were found
+        class Source {
+          public:
+            Source (const std::vector<size_t>& to_scan) : to_scan (to_scan), n (0) { }
+            bool operator() (size_t& index) {
+              if (n == to_scan.size())
+                return false;
+              index = to_scan[n++];
+              return true;
+            }
+          private:
+            const std::vector<size_t>& to_scan;
+            size_t n;
+        };
+
+        class Scanner {
+          public:
+            Scanner (std::vector<ScanEntry>& entries) : entries (entries) { }
+            bool operator() (const size_t& index, size_t& out) {
+              ScanEntry& entry (entries[index]);
+              entry.is_image = scan_file (entry.filename, entry.scan);
+              out = index;
+              return true;
+            }
+          private:
+            std::vector<ScanEntry>& entries;
+        };
+
+        class Sink {
+          public:
+            Sink (ProgressBar& progress) : progress (progress) { }
+            bool operator() (const size_t&) {
+              ++progress;
+              return true;
+            }
+          private:
+            ProgressBar& progress;
+        };
+
+      }
+
+
+
+
+      void Tree::list_dir (const std::string& filename, std::vector<std::string>& files, ProgressBar& progress)
       {
         try { 
           Path::Dir folder (filename); 
           std::string entry;
           while ((entry = folder.read_name()).size()) {
+            if (entry == Index::filename)
+              continue;
             std::string name (Path::join (filename, entry));
             if (Path::is_dir (name))
-              read_dir (name, progress);
-            else {
-              try { 
-                read_file (name); 
-              }
-              catch (Exception& E) { 
-                E.display (3);
-              }
-            }
+              list_dir (name, files, progress);
+            else 
+              files.push_back (name);
             ++progress;
           }
         }
@@ -99,26 +176,77 @@ namespace MR {
 
 
 
+      void Tree::read_dir (const std::string& filename)
+      {
+        std::vector<ScanEntry> entries;
+        {
+          std::vector<std::string> files;
+          ProgressBar progress ("scanning DICOM folder \"" + shorten (filename) + "\"", 0);
+          list_dir (filename, files, progress);
+          entries.resize (files.size());
+          for (size_t n = 0; n < files.size(); ++n)
+            entries[n].filename = files[n];
+        }
+
+        // Look up the index for files that have already been scanned
+        Index index (filename);
+        std::vector<size_t> to_scan;
+        for (size_t n = 0; n < entries.size(); ++n) {
+          ScanEntry& entry (entries[n]);
+          struct stat sbuf;
+          if (stat (entry.filename.c_str(), &sbuf)) {
+            entry.size = -1;
+            entry.mtime = 0;
+          }
+          else {
+            entry.size = sbuf.st_size;
+            entry.mtime = sbuf.st_mtime;
+          }
+          if (!index.find (entry.filename, entry.size, entry.mtime, entry.scan, entry.is_image))
+            to_scan.push_back (n);
+        }
+        if (index.enabled())
+          INFO ("DICOM index: " + str (entries.size() - to_scan.size()) + " of " + str (entries.size()) + " files up to date");
+
+        if (to_scan.size()) {
+          ProgressBar progress ("reading DICOM headers in \"" + shorten (filename) + "\"", to_scan.size());
+          Scanner scanner (entries);
+          Thread::run_queue (Source (to_scan), size_t(), Thread::multi (scanner), size_t(), Sink (progress));
+        }
+
+        for (size_t n = 0; n < to_scan.size(); ++n) {
+          const ScanEntry& entry (entries[to_scan[n]]);
+          if (entry.size >= 0)
+            index.add (entry.filename, entry.size, entry.mtime, entry.scan, entry.is_image);
+        }
+        index.save();
+
+        for (size_t n = 0; n < entries.size(); ++n)
+          if (entries[n].is_image)
+            add (entries[n].scan);
+      }
+
+
+
 
       void Tree::read_file (const std::string& filename)
       {
         QuickScan reader;
-        if (reader.read (filename)) {
-          INFO ("error reading file \"" + filename + "\" - assuming not DICOM"); 
-          return;
-        }
+        if (scan_file (filename, reader))
+          add (reader);
+      }
+
 
-        if (! (reader.dim[0] && reader.dim[1] && reader.bits_alloc && reader.data)) {
-          INFO ("DICOM file \"" + filename + "\" does not seem to contain image data - ignored"); 
-          return;
-        }
 
+
+      void Tree::add (const QuickScan& reader)
+      {
         RefPtr<Patient> patient = find (reader.patient, reader.patient_ID, reader.patient_DOB);
         RefPtr<Study> study = patient->find (reader.study, reader.study_ID, reader.study_date, reader.study_time);
         RefPtr<Series> series = study->find (reader.series, reader.series_number, reader.modality, reader.series_date, reader.series_time);
 
         RefPtr<Image> image (new Image);
-        image->filename = filename;
+        image->filename = reader.filename;
         image->series = series;
         image->sequence_name = reader.sequence;
         series->push_back (image);
@@ -130,9 +258,8 @@ namespace MR {
 
       void Tree::read (const std::string& filename)
       {
-        ProgressBar progress ("scanning DICOM folder \"" + shorten (filename) + "\"", 0);
         if (Path::is_dir (filename))
-          read_dir (filename, progress);
+          read_dir (filename);
         else {
           try {
             read_file (filename);
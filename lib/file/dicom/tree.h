@@ -25,6 +25,7 @@
 
 #include "ptr.h"
 #include "file/dicom/patient.h"
+#include "file/dicom/quick_scan.h"
 
 namespace MR {
   namespace File {
@@ -49,8 +50,10 @@ namespace MR {
           }
 
         protected:
-          void read_dir (const std::string& filename, ProgressBar& progress);
+          void list_dir (const std::string& filename, std::vector<std::string>& files, ProgressBar& progress);
+          void read_dir (const std::string& filename);
           void read_file (const std::string& filename);
+          void add (const QuickScan& reader);
       }; 
 
       std::ostream& operator<< (std::ostream& stream, const Tree& item);
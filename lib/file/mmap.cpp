@@ -42,7 +42,7 @@ namespace MR
   namespace File
   {
 
-    MMap::MMap (const Entry& entry, bool readwrite, bool preload, int64_t mapped_size) :
+    MMap::MMap (const Entry& entry, bool readwrite, bool preload, int64_t mapped_size, bool shared) :
       Entry (entry), addr (NULL), first (NULL), msize (mapped_size), readwrite (readwrite)
     {
       DEBUG (std::string (readwrite ? "creating RAM buffer for" : "memory-mapping" ) + " file \"" + Entry::name + "\"...");
@@ -59,7 +59,7 @@ namespace MR
       else if (start + msize > sbuf.st_size) 
         throw Exception ("file \"" + Entry::name + "\" is smaller than expected");
 
-      if (readwrite) {
+      if (readwrite && !shared) {
         try {
           first = new uint8_t [msize];
           if (!first) throw 1;
@@ -82,11 +82,13 @@ namespace MR
       }
       else {
 
-        if ( (fd = open (Entry::name.c_str(), O_RDONLY, 0666)) < 0)
+        if ( (fd = open (Entry::name.c_str(), readwrite ? O_RDWR : O_RDONLY, 0666)) < 0)
           throw Exception ("error opening file \"" + Entry::name + "\": " + strerror (errno));
 
         try {
 #ifdef MRTRIX_WINDOWS
+          if (shared) 
+            throw 0;
           HANDLE handle = CreateFileMapping ( (HANDLE) _get_osfhandle (fd), NULL,
               PAGE_READONLY, 0, start + msize, NULL);
           if (!handle) throw 0;
@@ -95,7 +97,7 @@ namespace MR
           CloseHandle (handle);
 #else
           addr = static_cast<uint8_t*> (mmap ( (char*) 0, start + msize,
-                PROT_READ, MAP_PRIVATE, fd, 0));
+                readwrite ? PROT_READ | PROT_WRITE : PROT_READ, shared ? MAP_SHARED : MAP_PRIVATE, fd, 0));
           if (addr == MAP_FAILED) throw 0;
 #endif
         }
@@ -123,7 +125,7 @@ namespace MR
 #ifdef MRTRIX_WINDOWS
         if (!UnmapViewOfFile ( (LPVOID) addr))
 #else
-          if (munmap (addr, msize))
+          if (munmap (addr, start + msize))
 #endif
             WARN ("error unmapping file \"" + Entry::name + "\": " + strerror (errno));
         close (fd);
@@ -52,8 +52,14 @@ namespace MR
          * By default, the whole file is mapped. If \a mapped_size is
          * non-zero, then only the region of size \a mapped_size starting from
          * the byte offset specified in \a entry will be mapped. 
+         *
+         * If \a shared is set to true, the file is mapped directly (no RAM
+         * buffer is used, even if \a readwrite is set), and shared with other
+         * processes mapping the same file: any changes made are immediately
+         * visible to them. This is used to stream piped images between
+         * commands. Not supported on Windows.
          */
-        MMap (const Entry& entry, bool readwrite = false, bool preload = true, int64_t mapped_size = -1);
+        MMap (const Entry& entry, bool readwrite = false, bool preload = true, int64_t mapped_size = -1, bool shared = false);
         ~MMap ();
 
         std::string name () const {
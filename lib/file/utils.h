@@ -57,6 +57,18 @@ namespace MR
       }
 
 
+      // directory in which to create the temporary files used to pipe images between commands:
+      // by default, use shared memory where available so that pipelines never touch disk
+      inline const std::string& pipe_tmpfile_dir () {
+#ifdef MRTRIX_WINDOWS
+        static const std::string __pipe_tmpfile_dir = File::Config::get ("TmpPipeDir", tmpfile_dir());
+#else
+        static const std::string __pipe_tmpfile_dir = File::Config::get ("TmpPipeDir", Path::is_dir ("/dev/shm") ? std::string ("/dev/shm") : tmpfile_dir());
+#endif
+        return __pipe_tmpfile_dir;
+      }
+
+
       const std::string& tmpfile_prefix () {
         static const std::string __tmpfile_prefix = File::Config::get ("TmpFilePrefix", "mrtrix-tmp-");
         return __tmpfile_prefix;
@@ -120,11 +132,11 @@ namespace MR
 
 
 
-    inline std::string create_tempfile (int64_t size = 0, const char* suffix = NULL)
+    inline std::string create_tempfile (int64_t size, const char* suffix, const std::string& dir)
     {
-      DEBUG ("creating temporary file of size " + str (size));
+      DEBUG ("creating temporary file of size " + str (size) + " in \"" + dir + "\"");
 
-      std::string filename (Path::join (tmpfile_dir(), tmpfile_prefix()) + "XXXXXX.");
+      std::string filename (Path::join (dir, tmpfile_prefix()) + "XXXXXX.");
       int rand_index = filename.size() - 7;
       if (suffix) filename += suffix;
 
@@ -136,7 +148,7 @@ namespace MR
       } while (fid < 0 && errno == EEXIST);
 
       if (fid < 0)
-        throw Exception (std::string ("error creating temporary file in current working directory: ") + strerror (errno));
+        throw Exception ("error creating temporary file in directory \"" + dir + "\": " + strerror (errno));
 
 
 
@@ -148,6 +160,12 @@ namespace MR
     }
 
 
+    inline std::string create_tempfile (int64_t size = 0, const char* suffix = NULL)
+    {
+      return create_tempfile (size, suffix, tmpfile_dir());
+    }
+
+
     inline void mkdir (const std::string& folder) 
     {
       if (::mkdir (folder.c_str()
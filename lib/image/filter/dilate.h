@@ -28,6 +28,7 @@
 #include "image/copy.h"
 #include "image/loop.h"
 #include "image/filter/base.h"
+#include "image/filter/distance_transform.h"
 
 
 
@@ -65,7 +66,9 @@ namespace MR
           template <class InfoType>
           Dilate (const InfoType& in) :
               Base (in),
-              npass_ (1)
+              npass_ (1),
+              radius_ (0.0),
+              use_radius (false)
           {
             datatype_ = DataType::Bit;
           }
@@ -74,6 +77,20 @@ namespace MR
           template <class InputVoxelType, class OutputVoxelType>
           void operator() (InputVoxelType& input, OutputVoxelType& output)
           {
+            if (use_radius) {
+              Ptr<ProgressBar> progress;
+              if (message.size())
+                progress = new ProgressBar (message);
+              std::vector<float> dist2;
+              distance_transform (input, dist2, true);
+              const float radius2 = Math::pow2 (radius_);
+              auto f = [&] (OutputVoxelType& out) {
+                out.value() = dist2[contiguous_offset (out)] <= radius2;
+              };
+              Image::ThreadedLoop (output).run (f, output);
+              return;
+            }
+
 
             RefPtr <BufferScratch<bool> > in_data (new BufferScratch<bool> (input));
             RefPtr <BufferScratch<bool>::voxel_type> in (new BufferScratch<bool>::voxel_type (*in_data));
@@ -107,6 +124,15 @@ namespace MR
             npass_ = npass;
           }
 
+          //! dilate by a physical distance (in mm) rather than by a number of passes,
+          //  using a Euclidean distance transform of the mask
+          void set_radius (float radius) {
+            if (radius < 0.0)
+              throw Exception ("radius for dilation filter must not be negative");
+            radius_ = radius;
+            use_radius = true;
+          }
+
 
         protected:
 
@@ -124,6 +150,8 @@ namespace MR
           }
 
           unsigned int npass_;
+          float radius_;
+          bool use_radius;
       };
       //! @}
     }
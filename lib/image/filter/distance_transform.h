@@ -0,0 +1,196 @@
+/*
+   Copyright 2014 Brain Research Institute, Melbourne, Australia
+
+   Written by David Raffelt, 2014.
+
+   This file is part of MRtrix.
+
+   MRtrix is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   MRtrix is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with MRtrix.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef __image_filter_distance_transform_h__
+#define __image_filter_distance_transform_h__
+
+#include <atomic>
+#include <limits>
+#include <vector>
+#include <stdint.h>
+
+#include "thread.h"
+#include "image/threaded_loop.h"
+#include "math/math.h"
+
+
+namespace MR
+{
+  namespace Image
+  {
+    namespace Filter
+    {
+
+      //! \cond skip
+      namespace DistanceTransformDetail {
+
+        // One pass of the separable distance transform along a single axis: each thread
+        //   processes whole lines, computing the lower envelope of the parabolas rooted
+        //   at each point along the line (Felzenszwalb & Huttenlocher, 2012)
+        class DistanceTransformPass {
+          public:
+            DistanceTransformPass (const size_t axis, const std::vector<size_t>& dim, const float spacing,
+                                   std::vector<float>& dist2, std::vector<uint32_t>* index, std::atomic<size_t>& next_line) :
+              length (dim[axis]),
+              stride (1),
+              num_lines (dist2.size() / dim[axis]),
+              spacing (spacing),
+              dist2 (dist2),
+              index (index),
+              next_line (next_line) {
+                for (size_t n = 0; n != axis; ++n)
+                  stride *= dim[n];
+              }
+
+            void execute () {
+              std::vector<float> f (length), z (length + 1);
+              std::vector<uint32_t> f_index (index ? length : 0), v (length);
+              size_t line;
+              while ((line = next_line++) < num_lines) {
+                const size_t offset = (line % stride) + (line / stride) * stride * length;
+                for (size_t q = 0; q != length; ++q) {
+                  f[q] = dist2[offset + q*stride];
+                  if (index)
+                    f_index[q] = (*index)[offset + q*stride];
+                }
+
+                int k = -1;
+                for (size_t q = 0; q != length; ++q) {
+                  if (!std::isfinite (f[q]))
+                    continue;
+                  float s = -std::numeric_limits<float>::infinity();
+                  while (k >= 0) {
+                    s = ((f[q] + Math::pow2 (q*spacing)) - (f[v[k]] + Math::pow2 (v[k]*spacing))) / (2.0 * spacing * (q - v[k]));
+                    if (s > z[k])
+                      break;
+                    --k;
+                  }
+                  if (k < 0)
+                    s = -std::numeric_limits<float>::infinity();
+                  v[++k] = q;
+                  z[k] = s;
+                }
+                if (k < 0)
+                  continue;
+
+                z[k+1] = std::numeric_limits<float>::infinity();
+                k = 0;
+                for (size_t q = 0; q != length; ++q) {
+                  while (z[k+1] < q*spacing)
+                    ++k;
+                  dist2[offset + q*stride] = Math::pow2 ((float(q) - float(v[k])) * spacing) + f[v[k]];
+                  if (index)
+                    (*index)[offset + q*stride] = f_index[v[k]];
+                }
+              }
+            }
+
+          private:
+            const size_t length;
+            size_t stride;
+            const size_t num_lines;
+            const float spacing;
+            std::vector<float>& dist2;
+            std::vector<uint32_t>* index;
+            std::atomic<size_t>& next_line;
+        };
+
+      }
+      //! \endcond
+
+
+
+      /** \addtogroup Filters
+        @{ */
+
+      //! compute the exact Euclidean distance transform of a set of points on a regular grid
+      /*! On input, \a dist2 holds zero at each feature point and infinity elsewhere, for a
+       * grid of dimensions \a dim stored with the first axis contiguous. On output, it
+       * holds the squared distance (in the units of \a spacing, usually mm) from each point
+       * to the nearest feature point. The transform is computed along the first three
+       * axes only; any further axes are treated as independent volumes. If \a index is
+       * provided, its values at the feature points are propagated, such that on output
+       * it holds the value of the nearest feature point.
+       *
+       * The transform is separable, and so requires a constant number of multi-threaded
+       * passes over the data regardless of the distances involved.
+       */
+      inline void distance_transform (std::vector<float>& dist2, std::vector<uint32_t>* index,
+                                      const std::vector<size_t>& dim, const std::vector<float>& spacing)
+      {
+        assert (dim.size() >= 3 && spacing.size() >= 3);
+        assert (!index || index->size() == dist2.size());
+        for (size_t axis = 0; axis != 3; ++axis) {
+          std::atomic<size_t> next_line (0);
+          DistanceTransformDetail::DistanceTransformPass pass (axis, dim, spacing[axis], dist2, index, next_line);
+          Thread::run (Thread::multi (pass), "distance transform");
+        }
+      }
+
+
+
+      //! get the offset of the current position of \a vox within a contiguous array
+      template <class VoxelType>
+        inline size_t contiguous_offset (const VoxelType& vox)
+        {
+          size_t offset = 0, stride = 1;
+          for (size_t n = 0; n != vox.ndim(); ++n) {
+            offset += vox[n] * stride;
+            stride *= vox.dim(n);
+          }
+          return offset;
+        }
+
+
+
+      //! compute the Euclidean distance transform of a binary mask image
+      /*! On output, \a dist2 holds for each voxel of \a mask (at the offset given by
+       * contiguous_offset()) the squared distance in mm to the nearest voxel in the same
+       * volume with value equal to \a target; this is infinite if there are none. */
+      template <class MaskVoxelType>
+        void distance_transform (MaskVoxelType& mask, std::vector<float>& dist2, const bool target)
+        {
+          std::vector<size_t> dim (std::max (mask.ndim(), size_t (3)), 1);
+          std::vector<float> spacing (3, 1.0);
+          for (size_t n = 0; n != mask.ndim(); ++n) {
+            dim[n] = mask.dim (n);
+            if (n < 3)
+              spacing[n] = mask.vox (n);
+          }
+
+          dist2.assign (Image::voxel_count (mask), std::numeric_limits<float>::infinity());
+          auto seed = [&] (MaskVoxelType& vox) {
+            if (bool (vox.value()) == target)
+              dist2[contiguous_offset (vox)] = 0.0;
+          };
+          Image::ThreadedLoop (mask).run (seed, mask);
+
+          distance_transform (dist2, nullptr, dim, spacing);
+        }
+      //! @}
+
+    }
+  }
+}
+
+
+#endif
@@ -28,14 +28,15 @@
 #include "image/buffer_scratch.h"
 #include "image/voxel.h"
 #include "image/filter/base.h"
-#include "image/filter/connected_components.h"
+#include "image/filter/lcc.h"
 #include "image/filter/median.h"
 #include "image/filter/optimal_threshold.h"
 #include "image/histogram.h"
 #include "image/copy.h"
-#include "image/loop.h"
+#include "image/threaded_loop.h"
 #include "dwi/gradient.h"
 #include "progressbar.h"
+#include "timer.h"
 
 namespace MR
 {
@@ -88,87 +89,118 @@ namespace MR
           template <class InputVoxelType, class OutputVoxelType>
           void operator() (InputVoxelType& input, OutputVoxelType& output) {
               typedef typename InputVoxelType::value_type value_type;
+              typedef typename BufferScratch<value_type>::voxel_type shell_voxel_type;
 
               Info info (input);
               info.set_ndim (3);
-              LoopInOrder loop (info, 0, 3);
-
-              // Generate a 'master' scratch buffer mask, to which all shells will contribute
-              BufferScratch<bool> mask_data (info, "DWI mask");
-              auto mask_voxel = mask_data.voxel();
 
               Ptr<ProgressBar> progress;
               if (message.size())
                 progress = new ProgressBar (message);
 
-              // Loop over each shell, including b=0, in turn
+              Timer timer;
+
+              // Compute the mean intensity image of every shell, including b=0,
+              //   in a single pass over the input
               DWI::Shells shells (grad);
+              VecPtr< BufferScratch<value_type> > shell_data;
+              std::vector<shell_voxel_type> shell_voxels;
               for (size_t s = 0; s != shells.count(); ++s) {
-                const DWI::Shell shell (shells[s]);
-
-                BufferScratch<value_type> shell_data (info, "mean b=" + str(size_t(std::round(shell.get_mean()))) + " image");
-                auto shell_voxel = shell_data.voxel();
-
-                for (auto l = loop (input, shell_voxel); l; ++l) {
-                  value_type mean = 0;
-                  for (std::vector<size_t>::const_iterator v = shell.get_volumes().begin(); v != shell.get_volumes().end(); ++v) {
-                    input[3] = *v;
-                    mean += input.value();
-                  }
-                  shell_voxel.value() = mean / value_type(shell.count());
-                }
-                if (progress)
-                  ++(*progress);
+                shell_data.push_back (new BufferScratch<value_type> (info, "mean b=" + str(size_t(std::round(shells[s].get_mean()))) + " image"));
+                shell_voxels.push_back (shell_data.back()->voxel());
+              }
+              ThreadedLoop (input, 0, 3).run (ShellMeans<shell_voxel_type> (shells, shell_voxels), input);
+              if (progress)
+                ++(*progress);
+              INFO ("DWI brain mask: shell means computed in " + str(timer.elapsed()) + " seconds");
 
-                // Threshold the mean intensity image for this shell
-                OptimalThreshold threshold_filter (shell_data);
+              // Threshold the mean intensity image of each shell, and add each to
+              //   a 'master' mask
+              timer.start();
+              BufferScratch<bool> mask_data (info, "DWI mask");
+              auto mask_voxel = mask_data.voxel();
+              for (size_t s = 0; s != shells.count(); ++s) {
+                OptimalThreshold threshold_filter (*shell_data[s]);
                 BufferScratch<bool> shell_mask_data (threshold_filter);
                 auto shell_mask_voxel = shell_mask_data.voxel();
-                threshold_filter (shell_voxel, shell_mask_voxel);
-                if (progress)
-                  ++(*progress);
+                threshold_filter (shell_voxels[s], shell_mask_voxel);
 
-                // Add this mask to the master
-                for (auto l = loop (mask_voxel, shell_mask_voxel); l; ++l) {
-                  if (shell_mask_voxel.value())
-                    mask_voxel.value() = true;
-                }
+                auto add = [] (decltype(mask_voxel)& mask, decltype(shell_mask_voxel)& shell_mask) {
+                  if (shell_mask.value())
+                    mask.value() = true;
+                };
+                ThreadedLoop (mask_voxel).run (add, mask_voxel, shell_mask_voxel);
                 if (progress)
                   ++(*progress);
-
               }
+              INFO ("DWI brain mask: shell thresholds computed in " + str(timer.elapsed()) + " seconds");
 
               // The following operations apply to the mask as combined from all shells
 
+              timer.start();
               BufferScratch<bool> temp_data (info, "temporary mask");
               auto temp_voxel = temp_data.voxel();
               Median median_filter (mask_voxel);
               median_filter (mask_voxel, temp_voxel);
               if (progress)
                 ++(*progress);
-
-              ConnectedComponents connected_filter (temp_voxel);
-              connected_filter.set_largest_only (true);
-              connected_filter (temp_voxel, temp_voxel);
+              INFO ("DWI brain mask: median filter applied in " + str(timer.elapsed()) + " seconds");
+
+              // Retain the largest connected component, then fill any holes by
+              //   retaining the largest connected component of the background
+              timer.start();
+              auto invert = [] (decltype(temp_voxel)& in, decltype(temp_voxel)& out) {
+                out.value() = !in.value();
+              };
+              LargestConnectedComponent connected_filter (temp_voxel);
+              connected_filter (temp_voxel, mask_voxel);
+              ThreadedLoop (mask_voxel).run (invert, mask_voxel, temp_voxel);
               if (progress)
                 ++(*progress);
 
-              for (auto l = loop (temp_voxel); l; ++l) 
-                temp_voxel.value() = !temp_voxel.value();
+              connected_filter (temp_voxel, mask_voxel);
+              auto write = [] (decltype(mask_voxel)& in, OutputVoxelType& out) {
+                out.value() = !in.value();
+              };
+              ThreadedLoop (mask_voxel).run (write, mask_voxel, output);
               if (progress)
                 ++(*progress);
-
-              connected_filter (temp_voxel, temp_voxel);
-              if (progress)
-                ++(*progress);
-
-              for (auto l = loop (temp_voxel, output); l; ++l) 
-                output.value() = !temp_voxel.value();
+              INFO ("DWI brain mask: connected components computed in " + str(timer.elapsed()) + " seconds");
           }
 
         protected:
           const Math::Matrix<float>& grad;
 
+          // Functor computing the mean across the volumes of each shell for a given voxel
+          template <class ShellVoxelType>
+          class ShellMeans {
+            public:
+              ShellMeans (const DWI::Shells& shells, const std::vector<ShellVoxelType>& shell_voxels) :
+                shells (shells),
+                shell_voxels (shell_voxels) { }
+
+              template <class InputVoxelType>
+              void operator() (InputVoxelType& input) {
+                typedef typename ShellVoxelType::value_type value_type;
+                for (size_t s = 0; s != shells.count(); ++s) {
+                  const DWI::Shell& shell (shells[s]);
+                  value_type mean = 0;
+                  for (std::vector<size_t>::const_iterator v = shell.get_volumes().begin(); v != shell.get_volumes().end(); ++v) {
+                    input[3] = *v;
+                    mean += input.value();
+                  }
+                  ShellVoxelType& out (shell_voxels[s]);
+                  for (size_t axis = 0; axis != 3; ++axis)
+                    out[axis] = input[axis];
+                  out.value() = mean / value_type(shell.count());
+                }
+              }
+
+            private:
+              const DWI::Shells& shells;
+              std::vector<ShellVoxelType> shell_voxels;
+          };
+
       };
       //! @}
     }
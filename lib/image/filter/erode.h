@@ -29,6 +29,7 @@
 #include "image/copy.h"
 #include "image/loop.h"
 #include "image/filter/base.h"
+#include "image/filter/distance_transform.h"
 
 namespace MR
 {
@@ -64,7 +65,9 @@ namespace MR
           template <class InfoType>
           Erode (const InfoType& in) :
               Base (in),
-              npass_ (1)
+              npass_ (1),
+              radius_ (0.0),
+              use_radius (false)
           {
             datatype_ = DataType::Bit;
           }
@@ -73,6 +76,25 @@ namespace MR
           template <class InputVoxelType, class OutputVoxelType>
           void operator() (InputVoxelType& input, OutputVoxelType& output) {
 
+            if (use_radius) {
+              Ptr<ProgressBar> progress;
+              if (message.size())
+                progress = new ProgressBar (message);
+              std::vector<float> dist2;
+              distance_transform (input, dist2, false);
+              const float radius2 = Math::pow2 (radius_);
+              // As with the neighbourhood filter, the region outside the image is treated as background
+              auto f = [&] (OutputVoxelType& out) {
+                bool value = dist2[contiguous_offset (out)] > radius2;
+                for (size_t n = 0; value && n != std::min (out.ndim(), size_t (3)); ++n)
+                  value = (std::min<ssize_t> (out[n] + 1, out.dim(n) - out[n]) * out.vox(n)) > radius_;
+                out.value() = value;
+              };
+              Image::ThreadedLoop (output).run (f, output);
+              return;
+            }
+
+
             RefPtr <BufferScratch<bool> > in_data (new BufferScratch<bool> (input));
             RefPtr <BufferScratch<bool>::voxel_type> in (new BufferScratch<bool>::voxel_type (*in_data));
             Image::copy (input, *in);
@@ -105,6 +127,15 @@ namespace MR
             npass_ = npass;
           }
 
+          //! erode by a physical distance (in mm) rather than by a number of passes,
+          //  using a Euclidean distance transform of the mask
+          void set_radius (float radius) {
+            if (radius < 0.0)
+              throw Exception ("radius for erosion filter must not be negative");
+            radius_ = radius;
+            use_radius = true;
+          }
+
 
         protected:
 
@@ -126,6 +157,8 @@ namespace MR
           }
 
           unsigned int npass_;
+          float radius_;
+          bool use_radius;
       };
       //! @}
     }
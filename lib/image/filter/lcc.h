@@ -23,10 +23,16 @@
 #ifndef __image_filter_lcc_h__
 #define __image_filter_lcc_h__
 
+#include <atomic>
+#include <limits>
+#include <vector>
+
 #include "point.h"
+#include "thread.h"
 #include "image/buffer_scratch.h"
 #include "image/copy.h"
 #include "image/nav.h"
+#include "image/threaded_loop.h"
 #include "image/filter/base.h"
 
 
@@ -39,6 +45,105 @@ namespace MR
 
 
 
+      //! \cond skip
+      // Union-find labelling of the connected components of a mask stored in a
+      //   contiguous array; each component is represented by its lowest voxel index
+      class LCCLabeller {
+        public:
+          static const uint32_t none = std::numeric_limits<uint32_t>::max();
+
+          LCCLabeller (const size_t* dim, const size_t num_slabs, const bool large_neighbourhood, std::vector<uint32_t>& parent) :
+            dim (dim),
+            num_slabs (num_slabs),
+            parent (parent) {
+              // Only neighbours preceding each voxel need to be tested
+              for (int z = -1; z <= 0; ++z) {
+                for (int y = -1; y <= 1; ++y) {
+                  for (int x = -1; x <= 1; ++x) {
+                    if (z == 0 && (y > 0 || (y == 0 && x >= 0)))
+                      continue;
+                    if (!large_neighbourhood && (std::abs (x) + std::abs (y) + std::abs (z)) != 1)
+                      continue;
+                    offsets.push_back (Point<int> (x, y, z));
+                  }
+                }
+              }
+            }
+
+          size_t slab_start (const size_t slab) const { return (slab * dim[2]) / num_slabs; }
+
+          // Join voxels in planes [z_from, z_to) with their preceding neighbours,
+          //   not looking beyond plane z_min
+          void label (const size_t z_from, const size_t z_to, const size_t z_min, const bool boundary_only) {
+            for (size_t z = z_from; z != z_to; ++z) {
+              for (size_t y = 0; y != dim[1]; ++y) {
+                for (size_t x = 0; x != dim[0]; ++x) {
+                  const size_t index = x + dim[0] * (y + dim[1] * z);
+                  if (parent[index] == none)
+                    continue;
+                  for (std::vector< Point<int> >::const_iterator o = offsets.begin(); o != offsets.end(); ++o) {
+                    if (boundary_only && !(*o)[2])
+                      continue;
+                    const ssize_t nx = x + (*o)[0], ny = y + (*o)[1], nz = z + (*o)[2];
+                    if (nx < 0 || nx >= ssize_t (dim[0]) || ny < 0 || ny >= ssize_t (dim[1]) || nz < ssize_t (z_min))
+                      continue;
+                    const size_t neighbour = nx + dim[0] * (ny + dim[1] * nz);
+                    if (parent[neighbour] != none)
+                      unite (index, neighbour);
+                  }
+                }
+              }
+            }
+          }
+
+          void merge_slabs () {
+            for (size_t slab = 1; slab < num_slabs; ++slab) {
+              const size_t z = slab_start (slab);
+              label (z, z + 1, 0, true);
+            }
+          }
+
+          class Slab {
+            public:
+              Slab (LCCLabeller& labeller, std::atomic<size_t>& next) : labeller (labeller), next (next) { }
+              void execute () {
+                size_t slab;
+                while ((slab = next++) < labeller.num_slabs) {
+                  const size_t z_from = labeller.slab_start (slab), z_to = labeller.slab_start (slab + 1);
+                  labeller.label (z_from, z_to, z_from, false);
+                }
+              }
+            private:
+              LCCLabeller& labeller;
+              std::atomic<size_t>& next;
+          };
+
+        private:
+          const size_t* dim;
+          const size_t num_slabs;
+          std::vector<uint32_t>& parent;
+          std::vector< Point<int> > offsets;
+
+          uint32_t find (uint32_t i) {
+            while (parent[i] != i) {
+              parent[i] = parent[parent[i]];
+              i = parent[i];
+            }
+            return i;
+          }
+
+          void unite (const uint32_t a, const uint32_t b) {
+            const uint32_t root_a = find (a), root_b = find (b);
+            if (root_a < root_b)
+              parent[root_b] = root_a;
+            else if (root_b < root_a)
+              parent[root_a] = root_b;
+          }
+      };
+      //! \endcond
+
+
+
       /** \addtogroup Filters
         @{ */
 
@@ -89,76 +194,56 @@ namespace MR
               if (message.size())
                 progress = new ProgressBar (message);
 
-              // Force calling the templated constructor instead of the copy-constructor
-              BufferScratch<bool> visited_data (input, "visited");
-              auto visited = visited_data.voxel();
-              size_t largest_mask_size = 0;
-
-              voxel_type seed (0, 0, 0);
-
-              std::vector<voxel_type> adj_voxels;
-              voxel_type offset;
-              for (offset[0] = -1; offset[0] <= 1; offset[0]++) {
-                for (offset[1] = -1; offset[1] <= 1; offset[1]++) {
-                  for (offset[2] = -1; offset[2] <= 1; offset[2]++) {
-                    if (offset.norm2() && (large_neighbourhood || offset.norm() == 1))
-                      adj_voxels.push_back (offset);
-                  }
+              const size_t dim[3] = { size_t (input.dim (0)), size_t (input.dim (1)), size_t (input.dim (2)) };
+              const size_t num_voxels = dim[0] * dim[1] * dim[2];
+              if (num_voxels >= size_t (LCCLabeller::none))
+                throw Exception ("Image too large for largest connected component filter");
+
+              // Each voxel in the mask initially forms its own component
+              std::vector<uint32_t> parent (num_voxels, LCCLabeller::none);
+              auto initialise = [&] (InputVoxelType& in) {
+                if (in.value()) {
+                  const size_t index = in[0] + dim[0] * (in[1] + dim[1] * in[2]);
+                  parent[index] = index;
                 }
+              };
+              ThreadedLoop (input, 0, 3).run (initialise, input);
+
+              // Label components within slabs of the image in parallel, then
+              //   merge those components that straddle the boundaries between slabs
+              const size_t num_slabs = std::min (Thread::number_of_threads(), dim[2]);
+              LCCLabeller labeller (dim, num_slabs, large_neighbourhood, parent);
+              {
+                std::atomic<size_t> next_slab (0);
+                LCCLabeller::Slab slab (labeller, next_slab);
+                Thread::run (Thread::multi (slab), "LCC labelling");
               }
-
-              for (seed[2] = 0; seed[2] != input.dim (2); ++seed[2]) {
-                for (seed[1] = 0; seed[1] != input.dim (1); ++seed[1]) {
-                  for (seed[0] = 0; seed[0] != input.dim (0); ++seed[0]) {
-                    if (!Image::Nav::get_value_at_pos (visited, seed) && Image::Nav::get_value_at_pos (input, seed)) {
-
-                      visited.value() = true;
-                      BufferScratch<value_type> local_mask_data (input, "local_mask");
-                      auto local_mask = local_mask_data.voxel();
-                      Image::Nav::set_value_at_pos (local_mask, seed, (value_type)input.value());
-                      size_t local_mask_size = 1;
-
-                      std::vector<voxel_type> to_expand (1, seed);
-
-                      do {
-
-                        const voxel_type v = to_expand.back();
-                        to_expand.pop_back();
-
-                        for (std::vector<voxel_type>::const_iterator step = adj_voxels.begin(); step != adj_voxels.end(); ++step) {
-                          voxel_type to_test (v);
-                          to_test += *step;
-                          if (Image::Nav::within_bounds (visited, to_test)
-                              && !Image::Nav::get_value_at_pos (visited, to_test)
-                              &&  Image::Nav::get_value_at_pos (input, to_test))
-                          {
-                            Image::Nav::set_value_at_pos (visited, to_test, true);
-                            Image::Nav::set_value_at_pos (local_mask, to_test, (value_type)input.value());
-                            ++local_mask_size;
-                            to_expand.push_back (to_test);
-                          }
-                        }
-
-                      } while (to_expand.size());
-
-                      if (local_mask_size > largest_mask_size) {
-                        largest_mask_size = local_mask_size;
-                        Image::copy (local_mask, output);
-                      }
-
-                      if (progress) ++(*progress);
-
-                    }
-                  }
+              labeller.merge_slabs();
+
+              // Every voxel's parent has a lower index, so a single ascending pass
+              //   points every voxel directly to the root of its component
+              std::vector<uint32_t> size (num_voxels, 0);
+              uint32_t largest = LCCLabeller::none;
+              for (size_t i = 0; i != num_voxels; ++i) {
+                if (parent[i] != LCCLabeller::none) {
+                  parent[i] = parent[parent[i]];
+                  ++size[parent[i]];
+                  if (largest == LCCLabeller::none || size[parent[i]] > size[largest])
+                    largest = parent[i];
                 }
               }
 
+              auto write = [&] (InputVoxelType& in, OutputVoxelType& out) {
+                const size_t index = in[0] + dim[0] * (in[1] + dim[1] * in[2]);
+                out.value() = (largest != LCCLabeller::none && parent[index] == largest) ? in.value() : value_type (0);
+              };
+              ThreadedLoop (input, 0, 3).run (write, input, output);
+
           }
 
 
         protected:
           bool large_neighbourhood;
-          typedef Point<int> voxel_type;
 
 
       };
@@ -31,6 +31,9 @@
 #include "image/filter/base.h"
 #include "math/golden_section_search.h"
 
+#include <limits>
+#include <vector>
+
 
 namespace MR
 {
@@ -152,6 +155,85 @@ namespace MR
           };
 
 
+          class RangeMomentsFunctor {
+            public:
+              RangeMomentsFunctor (double& overall_min, double& overall_max, double& overall_sum, double& overall_sum_sqr, size_t& overall_count) :
+                overall_min (overall_min), overall_max (overall_max), overall_sum (overall_sum), overall_sum_sqr (overall_sum_sqr), overall_count (overall_count),
+                min (std::numeric_limits<double>::infinity()), max (-std::numeric_limits<double>::infinity()), sum (0.0), sum_sqr (0.0), count (0) { }
+
+              ~RangeMomentsFunctor () {
+                overall_min = std::min (overall_min, min);
+                overall_max = std::max (overall_max, max);
+                overall_sum += sum;
+                overall_sum_sqr += sum_sqr;
+                overall_count += count;
+              }
+
+              template <class VoxelType>
+                void operator() (VoxelType& vox) {
+                  const double in = vox.value();
+                  if (std::isfinite (in)) {
+                    min = std::min (min, in);
+                    max = std::max (max, in);
+                    sum += in;
+                    sum_sqr += Math::pow2 (in);
+                    ++count;
+                  }
+                }
+
+              template <class VoxelType, class MaskVoxelType>
+                void operator() (VoxelType& vox, MaskVoxelType& mask) {
+                  if (mask.value())
+                    (*this) (vox);
+                }
+
+              double& overall_min;
+              double& overall_max;
+              double& overall_sum;
+              double& overall_sum_sqr;
+              size_t& overall_count;
+              double min, max, sum, sum_sqr;
+              size_t count;
+          };
+
+
+          class HistogramFunctor {
+            public:
+              HistogramFunctor (double min, double bin_width, std::vector<size_t>& overall_count, std::vector<double>& overall_sum) :
+                min (min), bin_width (bin_width), overall_count (overall_count), overall_sum (overall_sum),
+                count (overall_count.size(), 0), sum (overall_sum.size(), 0.0) { }
+
+              ~HistogramFunctor () {
+                for (size_t i = 0; i != count.size(); ++i) {
+                  overall_count[i] += count[i];
+                  overall_sum[i] += sum[i];
+                }
+              }
+
+              template <class VoxelType>
+                void operator() (VoxelType& vox) {
+                  const double in = vox.value();
+                  if (std::isfinite (in)) {
+                    const size_t bin = std::min (size_t ((in - min) / bin_width), count.size() - 1);
+                    ++count[bin];
+                    sum[bin] += in;
+                  }
+                }
+
+              template <class VoxelType, class MaskVoxelType>
+                void operator() (VoxelType& vox, MaskVoxelType& mask) {
+                  if (mask.value())
+                    (*this) (vox);
+                }
+
+              const double min, bin_width;
+              std::vector<size_t>& overall_count;
+              std::vector<double>& overall_sum;
+              std::vector<size_t> count;
+              std::vector<double> sum;
+          };
+
+
       }
       //! \endcond
 
@@ -210,22 +292,67 @@ namespace MR
         };
 
 
+#define OPTIMAL_THRESHOLD_HISTOGRAM_BINS 10000
+
+      //! estimate the threshold that maximises the correlation between the image and its binary mask
+      /*! Rather than evaluating the correlation cost function on the image for each
+       * candidate threshold, the image is read once to determine its range and moments,
+       * and once more to build a fine histogram of voxel counts & intensity sums; the
+       * cost for every bin boundary within the range then follows from cumulative sums
+       * over the histogram, and the global minimum is returned. */
       template <class InputVoxelType, class MaskVoxelType> 
         typename InputVoxelType::value_type estimate_optimal_threshold (InputVoxelType& input, MaskVoxelType* mask)
         {
           typedef typename InputVoxelType::value_type input_value_type;
 
-          input_value_type min, max;
-          Image::min_max (input, min, max);
+          double min = std::numeric_limits<double>::infinity(), max = -std::numeric_limits<double>::infinity();
+          double sum = 0.0, sum_sqr = 0.0;
+          size_t count = 0;
+          std::vector<size_t> bin_count (OPTIMAL_THRESHOLD_HISTOGRAM_BINS, 0);
+          std::vector<double> bin_sum (OPTIMAL_THRESHOLD_HISTOGRAM_BINS, 0.0);
 
-          input_value_type optimal_threshold = 0.0;
           {
-            ImageCorrelationCostFunction<InputVoxelType, MaskVoxelType> cost_function (input, mask);
-            optimal_threshold = Math::golden_section_search (cost_function, "optimising threshold...", 
-                min + 0.001*(max-min), (min+max)/2.0 , max-0.001*(max-min));
+            Image::ThreadedLoop loop ("optimising threshold...", input);
+            if (mask) {
+              Adapter::Replicate<MaskVoxelType> replicated_mask (*mask, input);
+              loop.run (RangeMomentsFunctor (min, max, sum, sum_sqr, count), input, replicated_mask);
+              if (count && max > min)
+                loop.run (HistogramFunctor (min, (max - min) / bin_count.size(), bin_count, bin_sum), input, replicated_mask);
+            } else {
+              loop.run (RangeMomentsFunctor (min, max, sum, sum_sqr, count), input);
+              if (count && max > min)
+                loop.run (HistogramFunctor (min, (max - min) / bin_count.size(), bin_count, bin_sum), input);
+            }
+          }
+
+          if (!count)
+            throw Exception ("Cannot estimate optimal threshold: no finite values in image");
+          if (max == min)
+            return min;
+
+          const double mean = sum / count;
+          const double stdev = std::sqrt ((sum_sqr - sum * mean) / count);
+          const double bin_width = (max - min) / bin_count.size();
+
+          // Voxels above each candidate threshold are those in all bins at or above it
+          double optimal_threshold = min, min_cost = std::numeric_limits<double>::infinity();
+          double above = 0.0, sum_above = 0.0;
+          for (size_t bin = bin_count.size(); bin-- > 0;) {
+            above += bin_count[bin];
+            sum_above += bin_sum[bin];
+            const double threshold = min + bin * bin_width;
+            if (threshold < min + 0.001*(max-min) || threshold > max - 0.001*(max-min) || !above || above == count)
+              continue;
+            const double covariance = (sum_above / count) - (above / count) * mean;
+            const double mask_stdev = std::sqrt ((above - (above * above) / count) / count);
+            const double cost = -covariance / (stdev * mask_stdev);
+            if (cost < min_cost) {
+              min_cost = cost;
+              optimal_threshold = threshold;
+            }
           }
 
-          return optimal_threshold;
+          return input_value_type (optimal_threshold);
         }
 
 
@@ -20,9 +20,14 @@
 
 */
 
+#ifndef MRTRIX_WINDOWS
+#include <sys/statvfs.h>
+#endif
+
 #include "file/utils.h"
 #include "file/path.h"
 #include "image/header.h"
+#include "image/utils.h"
 #include "image/handler/pipe.h"
 #include "image/format/list.h"
 
@@ -33,6 +38,30 @@ namespace MR
     namespace Format
     {
 
+      namespace {
+
+        // Shared memory is typically limited to a fraction of RAM: fall back to the
+        // regular temporary directory if the image would not fit
+        std::string pipe_dir (const Header& H)
+        {
+          const std::string& dir (File::pipe_tmpfile_dir());
+#ifndef MRTRIX_WINDOWS
+          if (dir != File::tmpfile_dir()) {
+            struct statvfs fs;
+            const int64_t required = Image::footprint (H) + 65536;
+            if (statvfs (dir.c_str(), &fs) || int64_t (fs.f_bavail) * int64_t (fs.f_frsize) < required) {
+              INFO ("insufficient space in \"" + dir + "\" for piped image - using \"" + File::tmpfile_dir() + "\" instead");
+              return File::tmpfile_dir();
+            }
+          }
+#endif
+          return dir;
+        }
+
+      }
+
+
+
       RefPtr<Handler::Base> Pipe::read (Header& H) const
       {
         if (H.name() == "-") {
@@ -65,7 +94,7 @@ namespace MR
         if (H.name() != "-")
           return false;
 
-        H.name() = File::create_tempfile (0, "mif");
+        H.name() = File::create_tempfile (0, "mif", pipe_dir (H));
 
         return mrtrix_handler.check (H, num_axes);
       }
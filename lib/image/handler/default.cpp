@@ -26,6 +26,7 @@
 #include "file/ofstream.h"
 #include "image/header.h"
 #include "image/handler/default.h"
+#include "image/handler/threaded_load.h"
 #include "image/utils.h"
 
 namespace MR
@@ -110,10 +111,15 @@ namespace MR
 
         if (is_new) memset (addresses[0], 0, files.size() * bytes_per_segment);
         else {
-          for (size_t n = 0; n < files.size(); n++) {
+          // each file maps to its own segment: read them concurrently
+          auto read_segment = [&] (size_t n) {
             File::MMap file (files[n], false, false, bytes_per_segment);
             memcpy (addresses[0] + n*bytes_per_segment, file.address(), bytes_per_segment);
-          }
+          };
+          if (files.size() > 1) 
+            threaded_load (files.size(), read_segment, "loading image \"" + shorten (name) + "\"...");
+          else 
+            read_segment (0);
         }
 
         if (addresses.size() > 1)
@@ -26,6 +26,7 @@
 #include "progressbar.h"
 #include "image/header.h"
 #include "image/handler/mosaic.h"
+#include "image/handler/threaded_load.h"
 #include "image/utils.h"
 
 namespace MR
@@ -36,6 +37,41 @@ namespace MR
     {
 
 
+      // each file holds a complete volume, and is unpacked into its own
+      // segment of the output buffer, so that files can be processed
+      // concurrently:
+      class Mosaic::Unmosaic {
+        public:
+          Unmosaic (const Mosaic& M, size_t bytes_per_segment) : 
+            M (M), bytes_per_segment (bytes_per_segment) { }
+
+          void operator() (size_t n) {
+            const size_t bytes = M.datatype.bytes();
+            File::MMap file (M.files[n], false, false, M.m_xdim * M.m_ydim * bytes);
+            uint8_t* data = M.addresses[0] + n * bytes_per_segment;
+            size_t nx = 0, ny = 0;
+            for (size_t z = 0; z < M.slices; z++) {
+              size_t ox = nx*M.xdim;
+              size_t oy = ny*M.ydim;
+              for (size_t y = 0; y < M.ydim; y++) {
+                memcpy (data, file.address() + bytes * (ox + M.m_xdim * (y+oy)), M.xdim * bytes);
+                data += M.xdim * bytes;
+              }
+              nx++;
+              if (nx >= M.m_xdim / M.xdim) {
+                nx = 0;
+                ny++;
+              }
+            }
+          }
+
+        private:
+          const Mosaic& M;
+          const size_t bytes_per_segment;
+      };
+
+
+
       void Mosaic::load ()
       {
         if (files.empty())
@@ -53,26 +89,8 @@ namespace MR
         if (!addresses[0])
           throw Exception ("failed to allocate memory for image \"" + name + "\"");
 
-        ProgressBar progress ("reformatting DICOM mosaic images...", slices*files.size());
-        uint8_t* data = addresses[0];
-        for (size_t n = 0; n < files.size(); n++) {
-          File::MMap file (files[n], false, false, m_xdim * m_ydim * datatype.bytes());
-          size_t nx = 0, ny = 0;
-          for (size_t z = 0; z < slices; z++) {
-            size_t ox = nx*xdim;
-            size_t oy = ny*ydim;
-            for (size_t y = 0; y < ydim; y++) {
-              memcpy (data, file.address() + datatype.bytes() * (ox + m_xdim* (y+oy)), xdim * datatype.bytes());
-              data += xdim * datatype.bytes();
-            }
-            nx++;
-            if (nx >= m_xdim / xdim) {
-              nx = 0;
-              ny++;
-            }
-            ++progress;
-          }
-        }
+        Unmosaic unmosaic (*this, bytes_per_segment);
+        threaded_load (files.size(), unmosaic, "reformatting DICOM mosaic images...");
 
         segsize = std::numeric_limits<size_t>::max();
       }
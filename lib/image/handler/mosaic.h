@@ -47,6 +47,8 @@ namespace MR
         protected:
           size_t m_xdim, m_ydim, xdim, ydim, slices;
 
+          class Unmosaic;
+
           virtual void load ();
           virtual void unload ();
       };
@@ -20,14 +20,25 @@
 
 */
 
+#include <atomic>
+#include <chrono>
 #include <limits>
+#include <thread>
+#include <fcntl.h>
+#include <signal.h>
 #include <unistd.h>
 
 #include "app.h"
+#include "file/config.h"
+#include "file/path.h"
 #include "image/header.h"
 #include "image/handler/pipe.h"
 #include "image/utils.h"
 
+#define PIPE_PROGRESS_CHECK_WORD 0x4D525350 // "MRSP"
+#define PIPE_PROGRESS_SUFFIX ".progress"
+#define PIPE_PROGRESS_POLL_INTERVAL_MS 2
+
 namespace MR
 {
   namespace Image
@@ -35,17 +46,40 @@ namespace MR
     namespace Handler
     {
 
+      // The record shared between producer and consumer via the sidecar file
+      struct Pipe::Progress {
+        uint32_t check_word;
+        int32_t pid;
+        std::atomic<uint64_t> ready; // number of complete slices; max() once the image is complete
+      };
+
+
+
+
       Pipe::~Pipe () 
       { 
         close(); 
         if (!is_new && files.size() == 1) {
-          DEBUG ("deleting piped image file \"" + files[0].name + "\"...");
-          unlink (files[0].name.c_str());
+          if (Path::exists (files[0].name)) {
+            DEBUG ("deleting piped image file \"" + files[0].name + "\"...");
+            unlink (files[0].name.c_str());
+          }
+          if (Path::exists (progress_path()))
+            unlink (progress_path().c_str());
         }
       }
 
 
 
+      bool Pipe::is_streaming () const
+      {
+        if (progress)
+          return true;
+        return !is_new && files.size() == 1 && Path::exists (progress_path());
+      }
+
+
+
       void Pipe::load ()
       {
         assert (files.size() == 1);
@@ -57,7 +91,39 @@ namespace MR
         if (double (bytes_per_segment) >= double (std::numeric_limits<size_t>::max()))
           throw Exception ("image \"" + name + "\" is larger than maximum accessible memory");
 
+#ifndef MRTRIX_WINDOWS
+        // If the PipeStreaming config option is set, pass the image downstream as soon as
+        // its header has been written, and map the data shared so that the consumer sees
+        // each slice as it is completed
+        if (is_new) {
+          if (File::Config::get_bool ("PipeStreaming", false))
+            open_progress();
+        }
+        else if (is_streaming()) {
+          open_progress();
+          if (writable || wait_on_load)
+            wait_for_completion();
+        }
+
+        // The file is mapped shared, so that the data are never copied: the producer writes
+        // straight into the (typically shared-memory) file, and the consumer reads from it
+        mmap = new File::MMap (files[0], writable, false, bytes_per_segment, true);
+        if (progress && is_new)
+          std::cout << files[0].name << std::endl;
+
+        // Once mapped by the consumer, the file can be removed: its contents remain accessible
+        //   via the mapping, and the memory is released as soon as the consumer terminates,
+        //   whether or not it does so cleanly
+        if (!is_new) {
+          DEBUG ("deleting piped image file \"" + files[0].name + "\"...");
+          unlink (files[0].name.c_str());
+          if (progress)
+            unlink (progress_path().c_str());
+        }
+#else
         mmap = new File::MMap (files[0], writable, !is_new, bytes_per_segment);
+#endif
+
         addresses.resize (1);
         addresses[0] = mmap->address();
       }
@@ -67,10 +133,81 @@ namespace MR
       {
         if (mmap) {
           mmap = NULL;
-          if (is_new)
-            std::cout << files[0].name << "\n";
+          if (is_new) {
+            if (progress)
+              progress->ready.store (std::numeric_limits<uint64_t>::max());
+            else
+              std::cout << files[0].name << "\n";
+          }
           addresses[0] = NULL;
         }
+        progress = NULL;
+        progress_mmap = NULL;
+      }
+
+
+
+      void Pipe::publish (size_t count)
+      {
+        if (!progress || !is_new)
+          return;
+        if (count > progress->ready.load())
+          progress->ready.store (count);
+      }
+
+
+
+      void Pipe::wait_for (size_t count) const
+      {
+        if (!progress || is_new)
+          return;
+        while (progress->ready.load() < count) {
+          if (kill (progress->pid, 0) && errno == ESRCH && progress->ready.load() < count)
+            throw Exception ("upstream command terminated before completing piped image \"" + name + "\"");
+          std::this_thread::sleep_for (std::chrono::milliseconds (PIPE_PROGRESS_POLL_INTERVAL_MS));
+        }
+      }
+
+
+
+      void Pipe::wait_for_completion () const
+      {
+        DEBUG ("waiting for upstream command to complete piped image \"" + name + "\"...");
+        wait_for (std::numeric_limits<uint64_t>::max());
+      }
+
+
+
+      std::string Pipe::progress_path () const
+      {
+        return files[0].name + PIPE_PROGRESS_SUFFIX;
+      }
+
+
+
+      void Pipe::open_progress ()
+      {
+        const std::string path (progress_path());
+        if (is_new) {
+          const int fid = ::open (path.c_str(), O_CREAT | O_RDWR | O_EXCL, 0666);
+          if (fid < 0)
+            throw Exception ("error creating pipe progress file \"" + path + "\": " + strerror (errno));
+          const int status = ftruncate (fid, sizeof (Progress));
+          ::close (fid);
+          if (status)
+            throw Exception ("cannot resize pipe progress file \"" + path + "\": " + strerror (errno));
+          progress_mmap = new File::MMap (File::Entry (path), true, false, sizeof (Progress), true);
+          progress = new (progress_mmap->address()) Progress;
+          progress->check_word = PIPE_PROGRESS_CHECK_WORD;
+          progress->pid = getpid();
+          progress->ready.store (0);
+        }
+        else {
+          progress_mmap = new File::MMap (File::Entry (path), false, true, sizeof (Progress), true);
+          progress = reinterpret_cast<Progress*> (progress_mmap->address());
+          if (progress->check_word != PIPE_PROGRESS_CHECK_WORD)
+            throw Exception ("invalid pipe progress file \"" + path + "\"");
+        }
       }
 
     }
@@ -34,17 +34,49 @@ namespace MR
     namespace Handler
     {
 
+      //! handler for images passed between commands via a Unix pipe
+      /*! If the \c PipeStreaming configuration option is set, the producer
+       * passes the image downstream as soon as its header has been written,
+       * and maps the data shared so that it is visible to the consumer as it
+       * is written. Progress is recorded in a small sidecar file as the number
+       * of slices along the outermost axis that have been completed (see
+       * publish()). By default, the consumer will wait in load() until the
+       * producer has finished; commands that process the data in
+       * outer-axis order can instead request streamed access (see
+       * Image::Stream), and call wait_for() before accessing each slice. */
       class Pipe : public Base
       {
         public:
-          Pipe (Base& handler) : Base (handler) { }
+          Pipe (Base& handler) : Base (handler), progress (NULL), wait_on_load (true) { }
           ~Pipe ();
 
+          //! whether the data are being streamed between commands
+          bool is_streaming () const;
+
+          //! do not wait for the producer to complete in load()
+          void set_streamed_access () {
+            wait_on_load = false;
+          }
+
+          //! (producer) signal that the first \a count slices along the outermost axis are complete
+          void publish (size_t count);
+
+          //! (consumer) wait until the first \a count slices along the outermost axis are complete
+          void wait_for (size_t count) const;
+
         protected:
           Ptr<File::MMap> mmap;
+          Ptr<File::MMap> progress_mmap;
+          struct Progress;
+          Progress* progress;
+          bool wait_on_load;
 
           virtual void load ();
           virtual void unload ();
+
+          std::string progress_path () const;
+          void open_progress ();
+          void wait_for_completion () const;
       };
 
     }
@@ -53,4 +85,3 @@ namespace MR
 
 #endif
 
-
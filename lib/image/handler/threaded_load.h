@@ -0,0 +1,146 @@
+/*
+   Copyright 2014 Brain Research Institute, Melbourne, Australia
+
+   Written by J-Donald Tournier, 2014.
+
+   This file is part of MRtrix.
+
+   MRtrix is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   MRtrix is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with MRtrix.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef __image_handler_threaded_load_h__
+#define __image_handler_threaded_load_h__
+
+#include <mutex>
+#include <exception>
+
+#include "ptr.h"
+#include "progressbar.h"
+#include "thread_queue.h"
+
+namespace MR
+{
+  namespace Image
+  {
+    namespace Handler
+    {
+
+      //! \cond skip
+      namespace ThreadedLoadDetail {
+
+        class __SegmentSource {
+          public:
+            __SegmentSource (size_t count) : n (0), count (count) { }
+            bool operator() (size_t& index) {
+              if (n >= count) 
+                return false;
+              index = n++;
+              return true;
+            }
+          private:
+            size_t n;
+            const size_t count;
+        };
+
+        template <class Functor>
+          class __SegmentLoader {
+            public:
+              __SegmentLoader (Functor& func, std::mutex& mutex, Ptr<Exception>& error) : 
+                func (func), mutex (mutex), error (error) { }
+              bool operator() (const size_t& index, size_t& out) {
+                // exceptions cannot propagate out of the worker threads: 
+                // record the first one, and rethrow once all threads have completed
+                try {
+                  func (index);
+                }
+                catch (Exception& E) {
+                  record (E);
+                }
+                catch (std::exception& E) {
+                  record (Exception (std::string ("error loading image segment: ") + E.what()));
+                }
+                out = index;
+                return true;
+              }
+            private:
+              Functor& func;
+              std::mutex& mutex;
+              Ptr<Exception>& error;
+
+              void record (const Exception& E) {
+                std::lock_guard<std::mutex> lock (mutex);
+                if (!error) 
+                  error = new Exception (E);
+              }
+          };
+
+        class __SegmentProgress {
+          public:
+            __SegmentProgress (ProgressBar* progress) : progress (progress) { }
+            bool operator() (const size_t&) {
+              if (progress) 
+                ++(*progress);
+              return true;
+            }
+          private:
+            ProgressBar* progress;
+        };
+
+      }
+      //! \endcond
+
+
+
+      //! invoke \a func (n) for each segment n in [0, count), concurrently
+      /*! Segments are dispatched in order to a bounded number of threads (at
+       * most the number of segments, and no more than
+       * Thread::number_of_threads()), so that files are read approximately in
+       * sequence. \a func must therefore be safe to invoke concurrently for
+       * different segments. If \a progress_message is non-empty, a progress
+       * bar is displayed with one increment per segment. Any exception thrown
+       * by \a func is rethrown once all threads have completed. */
+      template <class Functor>
+        void threaded_load (size_t count, Functor& func, const std::string& progress_message = std::string())
+        {
+          using namespace ThreadedLoadDetail;
+          std::mutex mutex;
+          Ptr<Exception> error;
+          Ptr<ProgressBar> progress (progress_message.size() ? new ProgressBar (progress_message, count) : NULL);
+          __SegmentLoader<Functor> loader (func, mutex, error);
+          const size_t nthreads = std::min (Thread::number_of_threads(), count);
+          if (nthreads <= 1) {
+            size_t out;
+            for (size_t n = 0; n < count; ++n) {
+              loader (n, out);
+              if (progress) 
+                ++(*progress);
+            }
+          }
+          else {
+            Thread::run_queue (
+                __SegmentSource (count), size_t(), 
+                Thread::multi (loader, nthreads), size_t(), 
+                __SegmentProgress (progress));
+          }
+          if (error)
+            throw Exception (*error);
+        }
+
+    }
+  }
+}
+
+#endif
+
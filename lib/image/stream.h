@@ -0,0 +1,108 @@
+/*
+   Copyright 2014 Brain Research Institute, Melbourne, Australia
+
+   Written by J-Donald Tournier, 2014.
+
+   This file is part of MRtrix.
+
+   MRtrix is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   MRtrix is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with MRtrix.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef __image_stream_h__
+#define __image_stream_h__
+
+#include "image/header.h"
+#include "image/handler/pipe.h"
+
+namespace MR
+{
+  namespace Image
+  {
+
+    //! Functions to stream piped images between commands
+    /*! When the \c PipeStreaming configuration option is set, an image
+     * written to a pipe is passed downstream as soon as its header is
+     * available. Commands that write their output in order along the outermost
+     * axis can call publish() as each slice is completed; commands that read
+     * their input in that order can call open_input() on the header before
+     * constructing the Buffer, and then wait_for() before accessing each
+     * slice. For any other image, these functions have no effect.
+     * For example:
+     * \code
+     * Image::Header header_in (argument[0]);
+     * Image::Stream::open_input (header_in);
+     * Image::Buffer<float> buffer_in (header_in);
+     * Image::Buffer<float> buffer_out (argument[1], header_in);
+     *
+     * const size_t axis = buffer_in.ndim() - 1;
+     * for (int n = 0; n < buffer_in.dim (axis); ++n) {
+     *   Image::Stream::wait_for (buffer_in, n+1);
+     *   // process slice n
+     *   Image::Stream::publish (buffer_out, n+1);
+     * }
+     * \endcode
+     */
+    namespace Stream
+    {
+
+      //! \cond skip
+      inline Handler::Pipe* __get_pipe (const Header& header)
+      {
+        return dynamic_cast<Handler::Pipe*> ((Handler::Base*) header.__get_handler());
+      }
+      //! \endcond
+
+      //! returns true if the image is being streamed from an upstream command
+      /*! If so, the data will be accessible before the upstream command has
+       * completed, and wait_for() must be invoked before accessing each
+       * slice. This must be invoked before the Buffer is constructed. */
+      inline bool open_input (Header& header)
+      {
+        Handler::Pipe* pipe = __get_pipe (header);
+        if (!pipe || !pipe->is_streaming())
+          return false;
+        pipe->set_streamed_access();
+        return true;
+      }
+
+      //! returns true if the (newly-created) image is being streamed to a downstream command
+      inline bool is_streamed (const Header& header)
+      {
+        Handler::Pipe* pipe = __get_pipe (header);
+        return pipe && pipe->is_streaming();
+      }
+
+      //! wait until the first \a count slices along the outermost axis of \a header are available
+      inline void wait_for (const Header& header, size_t count)
+      {
+        Handler::Pipe* pipe = __get_pipe (header);
+        if (pipe)
+          pipe->wait_for (count);
+      }
+
+      //! signal that the first \a count slices along the outermost axis of \a header are complete
+      inline void publish (const Header& header, size_t count)
+      {
+        Handler::Pipe* pipe = __get_pipe (header);
+        if (pipe)
+          pipe->publish (count);
+      }
+
+    }
+  }
+}
+
+#endif
+
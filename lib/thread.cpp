@@ -21,6 +21,13 @@
 */
 
 #include <thread>
+#include <deque>
+#include <fstream>
+
+#ifdef __linux__
+# include <pthread.h>
+# include <sched.h>
+#endif
 
 #include "app.h"
 #include "thread.h"
@@ -36,6 +43,170 @@ namespace MR
 
       size_t __number_of_threads = 0;
 
+
+
+      // parse a list of CPUs in the format used by the Linux sysfs
+      // (e.g. "0-3,8-11")
+      std::vector<int> parse_cpu_list (const std::string& spec)
+      {
+        std::vector<int> cpus;
+        for (const auto& range : split (spec, ",")) {
+          const auto limits = split (range, "-");
+          if (limits.empty() || strip (limits[0]).empty())
+            continue;
+          const int from = to<int> (strip (limits[0]));
+          const int to_cpu = limits.size() > 1 ? to<int> (strip (limits[1])) : from;
+          for (int n = from; n <= to_cpu; ++n)
+            cpus.push_back (n);
+        }
+        return cpus;
+      }
+
+
+
+      //CONF option: ThreadAffinity
+      //CONF default: none
+      //CONF the placement of worker threads onto CPU cores. Set to 'none'
+      //CONF to let the operating system schedule threads freely, 'compact'
+      //CONF to pin successive threads onto successive cores, filling each
+      //CONF NUMA node in turn, or 'scatter' to pin successive threads onto
+      //CONF cores on alternating NUMA nodes, to make use of the memory
+      //CONF bandwidth of all nodes. Only supported on Linux.
+
+      // the order in which worker threads are pinned to CPU cores (empty if
+      // thread affinity is not in use)
+      std::vector<int> cpu_placement ()
+      {
+        std::vector<int> cpus;
+#ifdef __linux__
+        const std::string mode = lowercase (File::Config::get ("ThreadAffinity", "none"));
+        if (mode == "none")
+          return cpus;
+        if (mode != "compact" && mode != "scatter") {
+          WARN ("unknown value \"" + mode + "\" for ThreadAffinity in configuration file - thread affinity disabled");
+          return cpus;
+        }
+
+        std::vector<std::vector<int>> nodes;
+        for (size_t n = 0; ; ++n) {
+          std::ifstream in ("/sys/devices/system/node/node" + str(n) + "/cpulist");
+          if (!in)
+            break;
+          std::string spec;
+          std::getline (in, spec);
+          nodes.push_back (parse_cpu_list (spec));
+        }
+        if (nodes.empty()) {
+          nodes.push_back (std::vector<int>());
+          for (size_t n = 0; n < std::thread::hardware_concurrency(); ++n)
+            nodes.back().push_back (n);
+        }
+
+        if (mode == "compact") {
+          for (const auto& node : nodes)
+            cpus.insert (cpus.end(), node.begin(), node.end());
+        }
+        else {
+          for (size_t n = 0; ; ++n) {
+            bool added = false;
+            for (const auto& node : nodes) {
+              if (n < node.size()) {
+                cpus.push_back (node[n]);
+                added = true;
+              }
+            }
+            if (!added)
+              break;
+          }
+        }
+        DEBUG ("thread affinity: pinning worker threads in order " + str(cpus));
+#endif
+        return cpus;
+      }
+
+
+
+      // the persistent pool of worker threads onto which all threads are
+      // dispatched
+      class Pool {
+        public:
+          Pool () : idle (0), starting (0), placement (cpu_placement()) {
+            std::lock_guard<std::mutex> lock (mutex);
+            for (size_t n = 0; n < number_of_threads(); ++n)
+              start_worker();
+          }
+
+          void dispatch (std::function<void()>&& task) {
+            std::lock_guard<std::mutex> lock (mutex);
+            tasks.push_back (std::move (task));
+            if (idle + starting >= tasks.size())
+              work_available.notify_one();
+            else
+              start_worker();
+          }
+
+          size_t size () {
+            std::lock_guard<std::mutex> lock (mutex);
+            return workers.size();
+          }
+
+        protected:
+          std::mutex mutex;
+          std::condition_variable work_available;
+          std::deque<std::function<void()>> tasks;
+          std::vector<std::thread> workers;
+          size_t idle, starting;
+          const std::vector<int> placement;
+
+          // must be called with mutex held
+          void start_worker () {
+            ++starting;
+            workers.push_back (std::thread (&Pool::run_worker, this, workers.size()));
+            // workers run for the lifetime of the process:
+            workers.back().detach();
+          }
+
+          void run_worker (size_t index) {
+            set_affinity (index);
+            std::unique_lock<std::mutex> lock (mutex);
+            --starting;
+            while (true) {
+              ++idle;
+              work_available.wait (lock, [this] { return !tasks.empty(); });
+              --idle;
+              std::function<void()> task (std::move (tasks.front()));
+              tasks.pop_front();
+              lock.unlock();
+              task();
+              lock.lock();
+            }
+          }
+
+          void set_affinity (size_t index) {
+#ifdef __linux__
+            if (placement.empty())
+              return;
+            cpu_set_t cpuset;
+            CPU_ZERO (&cpuset);
+            CPU_SET (placement[index % placement.size()], &cpuset);
+            if (pthread_setaffinity_np (pthread_self(), sizeof (cpu_set_t), &cpuset))
+              DEBUG ("unable to set affinity for worker thread " + str(index));
+#else
+            (void) index;
+#endif
+          }
+      };
+
+
+
+      Pool& pool ()
+      {
+        // never destroyed, since worker threads may still be blocked waiting
+        // for work (or running) when static objects are destroyed on exit:
+        static Pool* p = new Pool;
+        return *p;
+      }
+
     }
 
     //CONF option: NumberOfThreads
@@ -53,6 +224,20 @@ namespace MR
 
 
 
+    size_t pool_size ()
+    {
+      return pool().size();
+    }
+
+
+
+    void __dispatch (std::function<void()>&& task)
+    {
+      pool().dispatch (std::move (task));
+    }
+
+
+
 
 
     void (*__Backend::previous_print_func) (const std::string& msg) = nullptr;
@@ -25,6 +25,11 @@
 
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <vector>
 
 #include "debug.h"
 #include "exception.h"
@@ -56,7 +61,7 @@ namespace MR
         __Backend();
         ~__Backend();
 
-        size_t refcount;
+        std::atomic<size_t> refcount;
 
         std::mutex mutex;
         static void thread_print_func (const std::string& msg);
@@ -68,6 +73,35 @@ namespace MR
 
     extern __Backend* __backend;
 
+
+
+    // keeps track of the completion of a group of tasks dispatched to the
+    // thread pool
+    class __Team {
+      public:
+        __Team (size_t count) : remaining (count) { }
+
+        void done () {
+          std::lock_guard<std::mutex> lock (mutex);
+          if (!--remaining)
+            finished.notify_all();
+        }
+        void wait () {
+          std::unique_lock<std::mutex> lock (mutex);
+          finished.wait (lock, [this] { return !remaining; });
+        }
+
+      protected:
+        std::mutex mutex;
+        std::condition_variable finished;
+        size_t remaining;
+    };
+
+    // run task on one of the persistent worker threads, starting a new
+    // worker if none is currently idle, so that the task starts immediately
+    // (tasks may depend on each other, e.g. in Thread::run_queue())
+    void __dispatch (std::function<void()>&& task);
+
     namespace {
 
       class __thread_base {
@@ -85,8 +119,7 @@ namespace MR
             ++__backend->refcount;
           }
           void done() {
-            --__backend->refcount;
-            if (!__backend->refcount) {
+            if (!--__backend->refcount) {
               delete __backend;
               __backend = nullptr;
             }
@@ -100,20 +133,22 @@ namespace MR
             __single_thread (Functor&& functor, const std::string& name = "unnamed") :
             __thread_base (name) { 
               DEBUG ("launching thread \"" + name + "\"...");
-              typedef typename std::remove_reference<Functor>::type F;
-              thread = std::thread (&F::execute, &functor);
+              auto* f = &functor;
+              auto* t = team.get();
+              __dispatch ([f,t] { f->execute(); t->done(); });
             }
           __single_thread (const __single_thread& s) = delete;
           __single_thread (__single_thread&& s) = default;
 
           ~__single_thread () { 
+            if (!team) return;
             DEBUG ("waiting for completion of thread \"" + name + "\"...");
-            thread.join(); 
+            team->wait();
             DEBUG ("thread \"" + name + "\" completed OK");
           }
 
         protected:
-          std::thread thread;
+          std::unique_ptr<__Team> team { new __Team (1) };
       };
 
 
@@ -121,26 +156,28 @@ namespace MR
         class __multi_thread : public __thread_base {
           public:
             __multi_thread (Functor& functor, size_t nthreads, const std::string& name = "unnamed") :
-              __thread_base (name), functors (nthreads-1, functor) { 
+              __thread_base (name), team (new __Team (nthreads)), functors (nthreads-1, functor) { 
                 DEBUG ("launching " + str (nthreads) + " threads \"" + name + "\"...");
-                typedef typename std::remove_reference<Functor>::type F;
-                threads.reserve (nthreads);
-                for (auto& f : functors) 
-                  threads.push_back (std::thread (&F::execute, &f));
-                threads.push_back (std::thread (&F::execute, &functor));
+                auto* t = team.get();
+                for (auto& f : functors) {
+                  auto* fp = &f;
+                  __dispatch ([fp,t] { fp->execute(); t->done(); });
+                }
+                auto* fp = &functor;
+                __dispatch ([fp,t] { fp->execute(); t->done(); });
               }
 
             __multi_thread (const __multi_thread& m) = delete;
             __multi_thread (__multi_thread&& m) = default;
 
             ~__multi_thread () { 
+              if (!team) return;
               DEBUG ("waiting for completion of threads \"" + name + "\"...");
-              for (auto& t : threads) 
-                t.join();
+              team->wait();
               DEBUG ("threads \"" + name + "\" completed OK");
             }
           protected:
-            std::vector<std::thread> threads;
+            std::unique_ptr<__Team> team;
             std::vector<typename std::remove_reference<Functor>::type> functors;
 
         };
@@ -199,6 +236,15 @@ namespace MR
      * the -nthreads command-line option */
     size_t number_of_threads ();
 
+    /*! the number of worker threads currently held in the persistent thread
+     * pool. Threads launched via Thread::run() (and hence by the \ref
+     * thread_queue and \ref image_thread_looping APIs) are dispatched onto
+     * these workers rather than created afresh for each call. The pool is
+     * initially sized from Thread::number_of_threads(), and grows as
+     * required whenever more threads need to run concurrently (for example
+     * with nested parallelism, or the stages of a Thread::run_queue()). */
+    size_t pool_size ();
+
 
 
     //! used to request multiple threads of the corresponding functor
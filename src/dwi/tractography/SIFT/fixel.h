@@ -51,6 +51,9 @@ namespace MR
           Fixel (const FMLS::FOD_lobe& lobe) :
             FixelBase (lobe) { }
 
+          Fixel (const double amp, const double td, const float w, const Point<float>& d) :
+            FixelBase (amp, td, w, d) { }
+
           Fixel (const Fixel& that) :
             FixelBase (that) { }
 
@@ -0,0 +1,99 @@
+/*
+    Copyright 2014 Brain Research Institute, Melbourne, Australia
+
+    Written by Robert E. Smith, 2014.
+
+    This file is part of MRtrix.
+
+    MRtrix is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    MRtrix is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with MRtrix.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#include "dwi/tractography/SIFT/fixel_track_index.h"
+
+#include "progressbar.h"
+
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+      namespace SIFT
+      {
+
+
+
+      void FixelTrackIndex::build (const std::vector<TrackContribution*>& contributions, const size_t num_fixels)
+      {
+        ProgressBar progress ("Building fixel-streamline index...", 2 * contributions.size());
+
+        // First pass: count the number of streamlines traversing each fixel
+        offsets.assign (num_fixels + 1, 0);
+        for (std::vector<TrackContribution*>::const_iterator i = contributions.begin(); i != contributions.end(); ++i) {
+          if (*i) {
+            const TrackContribution& cont (**i);
+            for (size_t f = 0; f != cont.dim(); ++f)
+              ++offsets[cont[f].get_fixel_index() + 1];
+          }
+          ++progress;
+        }
+        for (size_t f = 1; f != offsets.size(); ++f)
+          offsets[f] += offsets[f-1];
+
+        // Second pass: fill the streamline indices; the same fixel may appear more than once
+        //   in a single streamline contribution, so duplicates are removed afterwards
+        std::vector<size_t> fill (offsets.begin(), offsets.end() - 1);
+        tracks.assign (offsets.back(), 0);
+        for (track_t t = 0; t != contributions.size(); ++t) {
+          if (contributions[t]) {
+            const TrackContribution& cont (*contributions[t]);
+            for (size_t f = 0; f != cont.dim(); ++f) {
+              const size_t fixel = cont[f].get_fixel_index();
+              if (fill[fixel] == offsets[fixel] || tracks[fill[fixel] - 1] != t)
+                tracks[fill[fixel]++] = t;
+            }
+          }
+          ++progress;
+        }
+
+        // Compact to remove the gaps left by duplicate entries
+        size_t out = 0;
+        for (size_t f = 0; f != num_fixels; ++f) {
+          const size_t start = offsets[f];
+          offsets[f] = out;
+          for (size_t i = start; i != fill[f]; ++i)
+            tracks[out++] = tracks[i];
+        }
+        offsets[num_fixels] = out;
+        tracks.resize (out);
+        std::vector<track_t> (tracks).swap (tracks);
+      }
+
+
+
+      void FixelTrackIndex::clear()
+      {
+        std::vector<size_t>().swap (offsets);
+        std::vector<track_t>().swap (tracks);
+      }
+
+
+
+      }
+    }
+  }
+}
@@ -0,0 +1,83 @@
+/*
+    Copyright 2014 Brain Research Institute, Melbourne, Australia
+
+    Written by Robert E. Smith, 2014.
+
+    This file is part of MRtrix.
+
+    MRtrix is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    MRtrix is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with MRtrix.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+
+#ifndef __dwi_tractography_sift_fixel_track_index_h__
+#define __dwi_tractography_sift_fixel_track_index_h__
+
+
+#include <vector>
+
+#include "dwi/tractography/SIFT/track_contribution.h"
+#include "dwi/tractography/SIFT/types.h"
+
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+      namespace SIFT
+      {
+
+
+
+
+      // Inverted index of the streamline contributions: for each fixel, stores the indices of all streamlines
+      //   that traverse it. This is stored in a compressed row format (one offset per fixel, and a single array of
+      //   streamline indices), so the memory requirement is one track_t per fixel-streamline contribution.
+      // Used during filtering to determine which streamlines need their gradients re-calculated, based on the
+      //   fixels that have been modified by streamline removal since the previous gradient calculation
+      class FixelTrackIndex
+      {
+
+        public:
+          FixelTrackIndex () { }
+
+          void build (const std::vector<TrackContribution*>&, const size_t num_fixels);
+          void clear();
+
+          bool   valid()     const { return offsets.size(); }
+          size_t num_fixels() const { return offsets.size() ? offsets.size() - 1 : 0; }
+
+          const track_t* begin (const size_t fixel) const { return tracks.data() + offsets[fixel]; }
+          const track_t* end   (const size_t fixel) const { return tracks.data() + offsets[fixel+1]; }
+          size_t         count (const size_t fixel) const { return offsets[fixel+1] - offsets[fixel]; }
+
+        private:
+          std::vector<size_t>  offsets;
+          std::vector<track_t> tracks;
+
+      };
+
+
+
+
+      }
+    }
+  }
+}
+
+
+#endif
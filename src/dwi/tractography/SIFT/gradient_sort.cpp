@@ -24,8 +24,12 @@
 #include "dwi/tractography/SIFT/gradient_sort.h"
 
 #include <algorithm>
+#include <iostream>
 
 #include "thread_queue.h"
+#include "timer.h"
+
+#include "math/rng.h"
 
 
 namespace MR
@@ -84,6 +88,105 @@ namespace MR
 
 
 
+      MT_gradient_vector_selector::MT_gradient_vector_selector (MT_gradient_vector_selector::VecType& in) :
+        null_candidate (in.size(), 0.0, 0.0)
+      {
+        const track_t num_threads = Thread::number_of_threads();
+        const track_t block_size = std::max (track_t(1), track_t ((in.size() + num_threads - 1) / num_threads));
+        TrackIndexRangeWriter source (block_size, in.size());
+        HeapBuilder pipe (in);
+        Thread::run_queue (source, TrackIndexRange(), Thread::multi (pipe), Block(), *this);
+
+        for (size_t i = 0; i != blocks.size(); ++i)
+          tournament.push_back (i);
+        std::make_heap (tournament.begin(), tournament.end(), TournamentComparator (blocks));
+      }
+
+
+
+
+      const Cost_fn_gradient_sort* MT_gradient_vector_selector::get()
+      {
+        if (tournament.empty())
+          return &null_candidate;
+        const TournamentComparator comparator (blocks);
+        std::pop_heap (tournament.begin(), tournament.end(), comparator);
+        Block& block (blocks[tournament.back()]);
+        std::pop_heap (block.begin, block.end, heap_compare);
+        --block.end;
+        const Cost_fn_gradient_sort* candidate = &*block.end;
+        if (block.begin == block.end)
+          tournament.pop_back();
+        else
+          std::push_heap (tournament.begin(), tournament.end(), comparator);
+        return candidate;
+      }
+
+
+
+
+      bool MT_gradient_vector_selector::HeapBuilder::operator() (const TrackIndexRange& in, Block& out) const
+      {
+        const VecItType begin (data.begin() + in.first), end (data.begin() + in.second);
+        const VecItType heap_end = std::partition (begin, end, [] (const Cost_fn_gradient_sort& i) { return (i.get_gradient_per_unit_length() < 0.0); });
+        std::make_heap (begin, heap_end, heap_compare);
+        out = Block (begin, heap_end);
+        return true;
+      }
+
+
+
+
+      void benchmark_candidate_selection (const track_t num_tracks)
+      {
+        Math::RNG rng;
+
+        std::vector<Cost_fn_gradient_sort> gradient_vector;
+        gradient_vector.assign (num_tracks, Cost_fn_gradient_sort (num_tracks, 0.0, 0.0));
+        // Fill the gradient vector with random Gaussian data
+        for (track_t index = 0; index != num_tracks; ++index) {
+          const float value = rng.normal();
+          gradient_vector[index].set (index, value, value);
+        }
+
+        std::vector<track_t> candidate_counts;
+        candidate_counts.push_back (std::max (track_t(1), num_tracks / 1000));
+        candidate_counts.push_back (std::max (track_t(1), num_tracks / 10));
+
+        std::vector<track_t> block_sizes;
+        for (track_t i = 16; i < num_tracks; i *= 2)
+          block_sizes.push_back (i);
+        block_sizes.push_back (num_tracks);
+
+        for (std::vector<track_t>::const_iterator c = candidate_counts.begin(); c != candidate_counts.end(); ++c) {
+          const track_t num_candidates = *c;
+
+          for (std::vector<track_t>::const_iterator i = block_sizes.begin(); i != block_sizes.end(); ++i) {
+            // Make a copy of the gradient vector, so the same data is processed each time
+            std::vector<Cost_fn_gradient_sort> temp_gv (gradient_vector);
+            Timer timer;
+            try {
+              MT_gradient_vector_sorter sorter (temp_gv, *i);
+              for (track_t candidate_count = 0; candidate_count < num_candidates; ++candidate_count)
+                sorter.get();
+              std::cerr << "Block sort: " << num_tracks << " tracks, " << num_candidates << " candidates, block size " << *i << " = " << timer.elapsed() * 1000.0 << "ms\n";
+            } catch (...) {
+              std::cerr << "Block sort: could not process " << num_tracks << " tracks with block size " << *i << "\n";
+            }
+          }
+
+          std::vector<Cost_fn_gradient_sort> temp_gv (gradient_vector);
+          Timer timer;
+          MT_gradient_vector_selector selector (temp_gv);
+          for (track_t candidate_count = 0; candidate_count < num_candidates; ++candidate_count)
+            selector.get();
+          std::cerr << "Heap selection: " << num_tracks << " tracks, " << num_candidates << " candidates = " << timer.elapsed() * 1000.0 << "ms\n";
+        }
+      }
+
+
+
+
       }
     }
   }
@@ -26,6 +26,7 @@
 #define __dwi_tractography_sift_sort_h__
 
 
+#include <algorithm>
 #include <set>
 #include <vector>
 
@@ -86,6 +87,8 @@ namespace MR
       //     is incremented and re-written to the set; this allows multiple streamlines from a single block to
       //     be filtered in a single iteration, provided the gradient is less than that of the candidate streamline
       //     from all other blocks
+      // Note that this requires a block size to be chosen heuristically; filtering now uses MT_gradient_vector_selector
+      //   (below), and this class is retained for benchmarking purposes
       class MT_gradient_vector_sorter
       {
 
@@ -156,6 +159,89 @@ namespace MR
 
 
 
+      // Candidate selection using per-thread heaps with a tournament merge; this does not require any block size
+      //   parameter, and avoids sorting the gradient vector:
+      // * Gradient vector is split into one contiguous block per thread
+      // * Within each block:
+      //     - Non-negative gradients are partitioned to the end of the block (these are never candidates)
+      //     - Negative gradients within the block are arranged into a binary heap, in O(n)
+      // * The block heaps are merged using a tournament: a small heap of block indices, ordered by the
+      //     best candidate of each block. get() pops the best candidate from the winning block heap
+      //     (O(log n)), and re-enters that block into the tournament (O(log(number of threads)))
+      // The cost of selection is therefore proportional to the number of candidates actually retrieved.
+      // Once all negative gradients have been retrieved, get() returns a null candidate with a zero gradient.
+      class MT_gradient_vector_selector
+      {
+
+          typedef std::vector<Cost_fn_gradient_sort> VecType;
+          typedef VecType::iterator VecItType;
+
+          class Block
+          {
+            public:
+              Block () { }
+              Block (const VecItType b, const VecItType e) : begin (b), end (e) { }
+              VecItType begin, end; // end is the end of the heap, not of the block
+          };
+
+          // Heap ordering such that the candidate with the most negative gradient per unit length is on top
+          static bool heap_compare (const Cost_fn_gradient_sort& a, const Cost_fn_gradient_sort& b) { return (b < a); }
+
+
+        public:
+          MT_gradient_vector_selector (VecType&);
+
+          const Cost_fn_gradient_sort* get();
+
+          bool operator() (const Block& in)
+          {
+            if (in.begin != in.end)
+              blocks.push_back (in);
+            return true;
+          }
+
+
+        private:
+          std::vector<Block> blocks;
+          std::vector<size_t> tournament;
+          const Cost_fn_gradient_sort null_candidate;
+
+
+          class TournamentComparator
+          {
+            public:
+              TournamentComparator (const std::vector<Block>& b) : blocks (b) { }
+              bool operator() (const size_t a, const size_t b) const {
+                // Ties broken by position in the gradient vector, so that selection is deterministic
+                const double ga = blocks[a].begin->get_gradient_per_unit_length(), gb = blocks[b].begin->get_gradient_per_unit_length();
+                return ((ga > gb) || (ga == gb && blocks[a].begin > blocks[b].begin));
+              }
+            private:
+              const std::vector<Block>& blocks;
+          };
+
+          class HeapBuilder
+          {
+            public:
+              HeapBuilder (VecType& in) :
+                data (in) { }
+              bool operator() (const TrackIndexRange&, Block&) const;
+            private:
+              VecType& data;
+          };
+
+
+      };
+
+
+
+
+      // Compare the performance of the candidate selection methods using a simulated gradient vector
+      void benchmark_candidate_selection (const track_t);
+
+
+
+
       }
     }
   }
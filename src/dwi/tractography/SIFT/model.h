@@ -44,12 +44,17 @@
 #include "dwi/tractography/mapping/voxel.h"
 
 #include "dwi/tractography/SIFT/model_base.h"
+#include "dwi/tractography/SIFT/snapshot.h"
 #include "dwi/tractography/SIFT/track_contribution.h"
 #include "dwi/tractography/SIFT/track_index_range.h"
 #include "dwi/tractography/SIFT/types.h"
 
 #include "image/loop.h"
 
+#include "file/entry.h"
+#include "file/mmap.h"
+#include "file/ofstream.h"
+
 #include "thread_queue.h"
 
 
@@ -95,6 +100,12 @@ namespace MR
 
           void output_non_contributing_streamlines (const std::string&) const;
 
+          // Save / load the complete model state (fixels, streamline contributions, removed streamlines) to / from
+          //   a binary snapshot file, so that the model can be re-used without FOD segmentation & streamline mapping
+          // Note that the Fixel class must provide a constructor from (FOD, TD, weight, direction)
+          void save_model (const std::string&) const;
+          void load_model (const std::string&, const std::string&);
+
 
           using ModelBase<Fixel>::mu;
 
@@ -111,6 +122,7 @@ namespace MR
           using ModelBase<Fixel>::FOD_sum;
           using ModelBase<Fixel>::H;
           using ModelBase<Fixel>::TD_sum;
+          using ModelBase<Fixel>::have_null_lobes;
 
 
           Model (const Model& that) : ModelBase<Fixel> (that) { assert (0); }
@@ -187,8 +199,8 @@ namespace MR
         {
           Mapping::TrackLoader loader (file, count);
           Mapping::TrackMapperBase mapper (H, dirs);
-          mapper.set_upsample_ratio (Mapping::determine_upsample_ratio (H, properties, 0.1));
-          mapper.set_use_precise_mapping (true);
+          mapper.set_upsample_ratio (Mapping::determine_upsample_ratio (H, properties, 0.333));
+          mapper.set_use_exact_mapping (true);
           MappedTrackReceiver receiver (*this);
           Thread::run_queue (
               loader,
@@ -333,6 +345,180 @@ namespace MR
 
 
 
+      template <class Fixel>
+      void Model<Fixel>::save_model (const std::string& path) const
+      {
+        size_t num_contributions = 0;
+        for (std::vector<TrackContribution*>::const_iterator i = contributions.begin(); i != contributions.end(); ++i) {
+          if (*i)
+            num_contributions += (*i)->dim();
+        }
+
+        std::map<std::string, std::string> header;
+        header["dim"] = str(H.dim(0)) + "," + str(H.dim(1)) + "," + str(H.dim(2));
+        header["vox"] = str(H.vox(0)) + "," + str(H.vox(1)) + "," + str(H.vox(2));
+        header["fixels"] = str(fixels.size());
+        header["tracks"] = str(contributions.size());
+        header["contributions"] = str(num_contributions);
+        header["contribution_size"] = str(sizeof (Track_fixel_contribution));
+        header["null_lobes"] = str(int(have_null_lobes));
+        header["tck_file"] = tck_file_path;
+
+        File::OFStream out (path, std::ios::out | std::ios::binary | std::ios::trunc);
+        write_snapshot_header (out, "SIFT model", header);
+        ProgressBar progress ("Writing SIFT model to file \"" + path + "\"...", 4);
+
+        const double sums[2] = { FOD_sum, TD_sum };
+        write_snapshot_data (out, sums, sizeof (sums));
+
+        // Voxel layout: index of first fixel & number of fixels, in order of the image axes
+        std::vector<uint64_t> voxels;
+        VoxelAccessor v (accessor);
+        for (auto l = Image::Loop() (v); l; ++l) {
+          const MapVoxel* voxel = v.value();
+          voxels.push_back (voxel ? voxel->first_index() : 0);
+          voxels.push_back (voxel ? voxel->num_fixels()  : 0);
+        }
+        write_snapshot_data (out, &voxels[0], voxels.size() * sizeof (uint64_t));
+        ++progress;
+
+        std::vector<SnapshotFixel> fixel_data (fixels.size());
+        for (size_t i = 0; i != fixels.size(); ++i) {
+          SnapshotFixel& f (fixel_data[i]);
+          f.FOD = fixels[i].get_FOD();
+          f.TD = fixels[i].get_TD();
+          f.weight = fixels[i].get_weight();
+          for (size_t axis = 0; axis != 3; ++axis)
+            f.dir[axis] = fixels[i].get_dir()[axis];
+        }
+        write_snapshot_data (out, &fixel_data[0], fixel_data.size() * sizeof (SnapshotFixel));
+        ++progress;
+
+        // Per-streamline data: offsets into the contributions array, totals, and the removed-streamline mask
+        std::vector<uint64_t> offsets (1, 0);
+        std::vector<float> totals;
+        std::vector<uint8_t> removed;
+        for (std::vector<TrackContribution*>::const_iterator i = contributions.begin(); i != contributions.end(); ++i) {
+          offsets.push_back (offsets.back() + (*i ? (*i)->dim() : 0));
+          totals.push_back (*i ? (*i)->get_total_contribution() : 0.0);
+          totals.push_back (*i ? (*i)->get_total_length() : 0.0);
+          removed.push_back (*i ? 0 : 1);
+        }
+        write_snapshot_data (out, &offsets[0], offsets.size() * sizeof (uint64_t));
+        write_snapshot_data (out, &totals[0], totals.size() * sizeof (float));
+        pad_snapshot_section (out, totals.size() * sizeof (float));
+        write_snapshot_data (out, &removed[0], removed.size());
+        pad_snapshot_section (out, removed.size());
+        ++progress;
+
+        for (std::vector<TrackContribution*>::const_iterator i = contributions.begin(); i != contributions.end(); ++i) {
+          if (*i && (*i)->dim())
+            write_snapshot_data (out, &(**i)[0], (*i)->dim() * sizeof (Track_fixel_contribution));
+        }
+        ++progress;
+      }
+
+
+
+
+      template <class Fixel>
+      void Model<Fixel>::load_model (const std::string& path, const std::string& tck_path)
+      {
+        std::map<std::string, std::string> header;
+        const int64_t offset = read_snapshot_header (path, "SIFT model", header);
+
+        const std::vector<int> dims = parse_ints (get_snapshot_entry (header, "dim", path));
+        const std::vector<float> voxs = parse_floats (get_snapshot_entry (header, "vox", path));
+        if (dims.size() != 3 || voxs.size() != 3)
+          throw Exception ("malformed image dimensions in SIFT model file \"" + path + "\"");
+        for (size_t axis = 0; axis != 3; ++axis) {
+          if (dims[axis] != H.dim(axis) || std::abs (voxs[axis] - H.vox(axis)) > 1e-4 * H.vox(axis))
+            throw Exception ("SIFT model file \"" + path + "\" does not match the image grid of the FOD image");
+        }
+        if (to<size_t> (get_snapshot_entry (header, "contribution_size", path)) != sizeof (Track_fixel_contribution))
+          throw Exception ("SIFT model file \"" + path + "\" was written using an incompatible streamline contribution storage format");
+
+        const size_t num_fixels = to<size_t> (get_snapshot_entry (header, "fixels", path));
+        const track_t num_tracks = to<track_t> (get_snapshot_entry (header, "tracks", path));
+        const size_t num_contributions = to<size_t> (get_snapshot_entry (header, "contributions", path));
+        const size_t num_voxels = size_t(dims[0]) * size_t(dims[1]) * size_t(dims[2]);
+
+        Tractography::Properties properties;
+        Tractography::Reader<float> file (tck_path, properties);
+        if (properties.find ("count") == properties.end() || to<track_t> (properties["count"]) != num_tracks)
+          throw Exception ("SIFT model file \"" + path + "\" does not match the number of streamlines in track file \"" + tck_path + "\"");
+        file.close();
+
+        const int64_t expected_size = 8 + 2 * sizeof (double)
+                                    + 2 * num_voxels * sizeof (uint64_t)
+                                    + num_fixels * sizeof (SnapshotFixel)
+                                    + (num_tracks + 1) * sizeof (uint64_t)
+                                    + snapshot_section_size (2 * num_tracks * sizeof (float))
+                                    + snapshot_section_size (num_tracks)
+                                    + num_contributions * sizeof (Track_fixel_contribution);
+        File::MMap mmap (File::Entry (path, offset));
+        const uint8_t* ptr = mmap.address();
+        check_snapshot_data (path, ptr, mmap.size(), expected_size);
+        ptr += 8;
+
+        ProgressBar progress ("Loading SIFT model from file \"" + path + "\"...", num_tracks);
+
+        const double* sums = reinterpret_cast<const double*> (ptr);
+        FOD_sum = sums[0];
+        TD_sum = sums[1];
+        ptr += 2 * sizeof (double);
+
+        const uint64_t* voxels = reinterpret_cast<const uint64_t*> (ptr);
+        VoxelAccessor v (accessor);
+        for (auto l = Image::Loop() (v); l; ++l) {
+          if (v.value())
+            delete v.value();
+          v.value() = voxels[1] ? new MapVoxel (voxels[0], voxels[1]) : nullptr;
+          voxels += 2;
+        }
+        ptr += 2 * num_voxels * sizeof (uint64_t);
+
+        const SnapshotFixel* fixel_data = reinterpret_cast<const SnapshotFixel*> (ptr);
+        fixels.clear();
+        fixels.reserve (num_fixels);
+        for (size_t i = 0; i != num_fixels; ++i) {
+          const SnapshotFixel& f (fixel_data[i]);
+          fixels.push_back (Fixel (f.FOD, f.TD, f.weight, Point<float> (f.dir[0], f.dir[1], f.dir[2])));
+        }
+        ptr += num_fixels * sizeof (SnapshotFixel);
+
+        const uint64_t* offsets = reinterpret_cast<const uint64_t*> (ptr);
+        ptr += (num_tracks + 1) * sizeof (uint64_t);
+        const float* totals = reinterpret_cast<const float*> (ptr);
+        ptr += snapshot_section_size (2 * num_tracks * sizeof (float));
+        const uint8_t* removed = ptr;
+        ptr += snapshot_section_size (num_tracks);
+        const Track_fixel_contribution* data = reinterpret_cast<const Track_fixel_contribution*> (ptr);
+
+        for (std::vector<TrackContribution*>::iterator i = contributions.begin(); i != contributions.end(); ++i) {
+          if (*i)
+            delete *i;
+        }
+        contributions.assign (num_tracks, nullptr);
+        for (track_t t = 0; t != num_tracks; ++t) {
+          if (!removed[t]) {
+            const std::vector<Track_fixel_contribution> track_data (data + offsets[t], data + offsets[t+1]);
+            contributions[t] = new TrackContribution (track_data, totals[2*t], totals[2*t+1]);
+          }
+          ++progress;
+        }
+
+        have_null_lobes = to<int> (get_snapshot_entry (header, "null_lobes", path));
+        tck_file_path = tck_path;
+
+        INFO ("Proportionality coefficient of loaded SIFT model is " + str (mu()));
+      }
+
+
+
+
+
+
       template <class Fixel>
       Model<Fixel>::MappedTrackReceiver::~MappedTrackReceiver()
       {
@@ -99,6 +99,12 @@ namespace MR
             weight (1.0),
             dir (lobe.get_mean_dir()) { }
 
+          FixelBase (const double amp, const double td, const float w, const Point<float>& d) :
+            FOD (amp),
+            TD (td),
+            weight (w),
+            dir (d) { }
+
           FixelBase (const FixelBase& that) :
             FOD (that.FOD),
             TD (that.TD),
@@ -274,8 +280,8 @@ namespace MR
 
         Mapping::TrackLoader loader (file, count);
         Mapping::TrackMapperBase mapper (H, dirs);
-        mapper.set_upsample_ratio (Mapping::determine_upsample_ratio (H, properties, 0.1));
-        mapper.set_use_precise_mapping (true);
+        mapper.set_upsample_ratio (Mapping::determine_upsample_ratio (H, properties, 0.333));
+        mapper.set_use_exact_mapping (true);
         Thread::run_queue (
             loader,
             Thread::batch (Tractography::Streamline<float>()),
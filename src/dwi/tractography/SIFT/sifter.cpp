@@ -1,10 +1,12 @@
 
 #include "dwi/tractography/SIFT/sifter.h"
 
+#include <cstdio>
+
+#include "bitset.h"
 #include "point.h"
 #include "progressbar.h"
 #include "ptr.h"
-#include "timer.h"
 
 #include "dwi/tractography/file.h"
 #include "dwi/tractography/properties.h"
@@ -15,13 +17,17 @@
 #include "dwi/tractography/mapping/mapper.h"
 #include "dwi/tractography/mapping/mapping.h"
 
-#include "math/rng.h"
+#include "dwi/tractography/SIFT/snapshot.h"
 
 #include "image/buffer.h"
 #include "image/buffer_sparse.h"
 #include "image/loop.h"
 
+#include "file/entry.h"
+#include "file/mmap.h"
 #include "file/ofstream.h"
+#include "file/path.h"
+#include "file/utils.h"
 
 
 
@@ -46,10 +52,13 @@ namespace MR
         enum recalc_reason { UNDEFINED, NONLINEARITY, QUANTISATION, TERM_COUNT, TERM_RATIO, TERM_MU, POS_GRADIENT };
 
         // For streamlines that do not contribute to the map, remove an equivalent proportion of length to those that do contribute
-        double sum_contributing_length = 0.0, sum_noncontributing_length = 0.0;
+        // If resuming from a checkpoint, the lengths of streamlines already removed must also be included
+        double sum_contributing_length = resume_contributing_length_removed, sum_noncontributing_length = resume_noncontributing_length_removed;
+        unsigned int tracks_remaining = 0;
         std::vector<track_t> noncontributing_indices;
         for (track_t i = 0; i != contributions.size(); ++i) {
           if (contributions[i]) {
+            ++tracks_remaining;
             if (contributions[i]->get_total_contribution()) {
               sum_contributing_length    += contributions[i]->get_total_length();
             } else {
@@ -58,29 +67,44 @@ namespace MR
             }
           }
         }
-        double contributing_length_removed = 0.0, noncontributing_length_removed = 0.0;
+        // Outputs requested at streamline counts that have already been passed (i.e. when
+        //   resuming from a checkpoint) can no longer be generated
+        while (!output_at_counts.empty() && output_at_counts.back() > tracks_remaining) {
+          INFO ("Output at " + str (output_at_counts.back()) + " streamlines skipped: only " + str (tracks_remaining) + " streamlines remain");
+          output_at_counts.pop_back();
+        }
+        double contributing_length_removed = resume_contributing_length_removed, noncontributing_length_removed = resume_noncontributing_length_removed;
         // Randomise the order or removal here; faster than trying to select at random later
         std::random_shuffle (noncontributing_indices.begin(), noncontributing_indices.end());
 
         std::vector<Cost_fn_gradient_sort> gradient_vector;
         gradient_vector.assign (num_tracks(), Cost_fn_gradient_sort (num_tracks(), std::numeric_limits<double>::max(), std::numeric_limits<double>::max()));
-        unsigned int tracks_remaining = num_tracks();
+
+        // If requested, build an inverted index of fixels to streamlines; then, following the first iteration,
+        //   only those streamlines traversing fixels modified by streamline removal have their gradients re-calculated
+        FixelTrackIndex fixel_tracks;
+        if (incremental_gradients)
+          fixel_tracks.build (contributions, fixels.size());
+        BitSet fixel_modified (incremental_gradients ? fixels.size() : 0), track_affected (incremental_gradients ? num_tracks() : 0);
+        std::vector<size_t> modified_fixels;
+        std::vector<track_t> affected_tracks;
+        bool full_recalculation = true;
 
         if (tracks_remaining < term_number)
           throw Exception ("Filtering failed; desired number of filtered streamlines is greater than or equal to the size of the input dataset");
 
-        const double init_cf = calc_cost_function();
-        unsigned int iteration = 0;
+        const double init_cf = resume_iteration ? resume_init_cf : calc_cost_function();
+        unsigned int iteration = resume_iteration;
 
         if (!csv_path.empty()) {
           File::OFStream csv_out (csv_path, std::ios_base::out | std::ios_base::trunc);
           csv_out << "Iteration,Removed this iteration,Total removed,Remaining,Cost,TD,Mu,Recalculation,\n";
-          csv_out << "0,0,0," << str (tracks_remaining) << "," << str (init_cf) << "," << str (TD_sum) << "," << str (mu()) << ",Start,\n";
+          csv_out << str (iteration) << ",0," << str (num_tracks() - tracks_remaining) << "," << str (tracks_remaining) << "," << str (calc_cost_function()) << "," << str (TD_sum) << "," << str (mu()) << "," << (resume_iteration ? "Resume" : "Start") << ",\n";
         }
 
         if (App::log_level) {
           fprintf (stderr, "%s:   Iteration    Tracks removed     Tracks remaining     Cost function %%\n", App::NAME.c_str());
-          fprintf (stderr, "%s:    %6u           %7u            %9u              %.2f%%  ", App::NAME.c_str(), iteration, 0, tracks_remaining, 100.0);
+          fprintf (stderr, "%s:    %6u           %7u            %9u              %.2f%%  ", App::NAME.c_str(), iteration, 0, tracks_remaining, 100.0 * calc_cost_function() / init_cf);
         }
 
         bool another_iteration = true;
@@ -95,27 +119,49 @@ namespace MR
           const double current_roc_cf = calc_roc_cost_function();
 
 
-          TrackIndexRangeWriter range_writer (SIFT_TRACK_INDEX_BUFFER_SIZE, num_tracks());
-          TrackGradientCalculator gradient_calculator (*this, gradient_vector, current_mu, current_roc_cf);
-          Thread::run_queue (range_writer, TrackIndexRange(), Thread::multi (gradient_calculator));
+          const bool gradients_incremental = !full_recalculation;
+          if (full_recalculation) {
+
+            TrackIndexRangeWriter range_writer (SIFT_TRACK_INDEX_BUFFER_SIZE, num_tracks());
+            TrackGradientCalculator gradient_calculator (*this, gradient_vector, current_mu, current_roc_cf);
+            Thread::run_queue (range_writer, TrackIndexRange(), Thread::multi (gradient_calculator));
+
+          } else {
+
+            // Candidate selection permutes the gradient vector; restore it to streamline order
+            for (track_t i = 0; i != gradient_vector.size(); ++i) {
+              while (gradient_vector[i].get_tck_index() != i)
+                std::swap (gradient_vector[i], gradient_vector[gradient_vector[i].get_tck_index()]);
+            }
+
+            // Only streamlines traversing a fixel modified since the previous calculation need to be updated;
+            //   this includes the streamlines that have been removed, which are nullified
+            for (std::vector<size_t>::const_iterator f = modified_fixels.begin(); f != modified_fixels.end(); ++f) {
+              for (const track_t* t = fixel_tracks.begin (*f); t != fixel_tracks.end (*f); ++t) {
+                if (!track_affected[*t]) {
+                  track_affected[*t] = true;
+                  affected_tracks.push_back (*t);
+                }
+              }
+            }
+
+            TrackIndexRangeWriter range_writer (SIFT_TRACK_INDEX_BUFFER_SIZE, affected_tracks.size());
+            TrackGradientCalculator gradient_calculator (*this, gradient_vector, current_mu, current_roc_cf, &affected_tracks);
+            Thread::run_queue (range_writer, TrackIndexRange(), Thread::multi (gradient_calculator));
 
+            for (std::vector<track_t>::const_iterator t = affected_tracks.begin(); t != affected_tracks.end(); ++t)
+              track_affected[*t] = false;
+            affected_tracks.clear();
 
-          // Theoretically possible to optimise the sorting block size at execution time
-          // * Estimate the smallest possible block size that will not overload the std::set
-          // * Simulate a gradient vector using a Gaussian distribution of gradients (ignore length dependence)
-          // * Simulate sorting this gradient vector; need to simulate both the sort, and some number of get() calls
-          // * Perform a golden section search to find the optimal block size
-          // This wasn't implemented as the optimal block size seems pretty stable regardless of gradient vector size
+          }
 
-          // Ideally the sorting block size should change dynamically as streamlines are filtered
-          // This is to reduce the load on the single-threaded section as the multi-threaded sorting complexity declines
-          //   (as more streamlines are no longer present, hence have a null gradient and are excluded from the full sort)
-          // Tried for an algebraic solution but the numbers didn't line up with my experiments
-          // Trying a heuristic for now; go for a sort size of 1000 following initial sort, assuming half of all
-          //   remaining streamlines have a negative gradient
+          for (std::vector<size_t>::const_iterator f = modified_fixels.begin(); f != modified_fixels.end(); ++f)
+            fixel_modified[*f] = false;
+          modified_fixels.clear();
+          full_recalculation = !incremental_gradients;
 
-          const track_t sort_size = std::min (num_tracks() / double(Thread::number_of_threads()), std::round (2000.0 * double(num_tracks()) / double(tracks_remaining)));
-          MT_gradient_vector_sorter sorter (gradient_vector, sort_size);
+
+          MT_gradient_vector_selector selector (gradient_vector);
 
           // Remove candidate streamlines one at a time, and correspondingly modify the fixels to which they were attributed
           unsigned int removed_this_iteration = 0;
@@ -161,14 +207,19 @@ namespace MR
 
             } else { // Proceed as normal
 
-              const std::vector<Cost_fn_gradient_sort>::iterator candidate = sorter.get();
+              const Cost_fn_gradient_sort* candidate = selector.get();
 
               const track_t candidate_index = candidate->get_tck_index();
 
               if (candidate->get_cost_gradient() >= 0.0) {
                 recalculate = POS_GRADIENT;
-                if (!removed_this_iteration)
-                  another_iteration = false;
+                if (!removed_this_iteration) {
+                  // Gradients of streamlines not traversing any modified fixel may be stale; confirm using a full re-calculation
+                  if (gradients_incremental)
+                    full_recalculation = true;
+                  else
+                    another_iteration = false;
+                }
                 goto end_iteration;
               }
 
@@ -206,7 +257,12 @@ namespace MR
                 // Candidate streamline removal meets all criteria; remove from reconstruction
                 for (size_t f = 0; f != candidate_contribution.dim(); ++f) {
                   const Track_fixel_contribution& fixel_cont = candidate_contribution[f];
-                  fixels[fixel_cont.get_fixel_index()] -= fixel_cont.get_length();
+                  const size_t fixel_index = fixel_cont.get_fixel_index();
+                  fixels[fixel_index] -= fixel_cont.get_length();
+                  if (incremental_gradients && !fixel_modified[fixel_index]) {
+                    fixel_modified[fixel_index] = true;
+                    modified_fixels.push_back (fixel_index);
+                  }
                 }
                 TD_sum -= candidate_contribution.get_total_contribution();
                 contributing_length_removed += candidate_contribution.get_total_length();
@@ -225,7 +281,10 @@ namespace MR
                   recalculate = TERM_RATIO;
                 else
                   recalculate = QUANTISATION;
-                if (!removed_this_iteration) {
+                if (!removed_this_iteration && gradients_incremental) {
+                  // Gradients of streamlines not traversing any modified fixel may be stale; confirm using a full re-calculation
+                  full_recalculation = true;
+                } else if (!removed_this_iteration) {
                   // If filtering has been completed to convergence, but the user does not want to filter to convergence
                   //   (i.e. they have defined a desired termination criterion but it has not yet been met), disable
                   //   the quantisation check to give the algorithm a chance to meet the user's termination request
@@ -270,6 +329,9 @@ namespace MR
             csv_out << ",\n";
           }
 
+          if (!checkpoint_path.empty())
+            save_checkpoint (iteration, init_cf, contributing_length_removed, noncontributing_length_removed);
+
         } while (another_iteration);
 
         if (App::log_level)
@@ -341,65 +403,104 @@ namespace MR
 
 
 
-      void SIFTer::set_regular_outputs (const std::vector<int>& in, const bool b)
+      void SIFTer::load_checkpoint (const std::string& path)
       {
-        for (std::vector<int>::const_iterator i = in.begin(); i != in.end(); ++i) {
-          if (*i > 0 && *i <= (int)contributions.size())
-            output_at_counts.push_back (*i);
+        std::map<std::string, std::string> header;
+        const int64_t offset = read_snapshot_header (path, "SIFT checkpoint", header);
+        if (to<size_t> (get_snapshot_entry (header, "fixels", path)) != fixels.size()
+            || to<track_t> (get_snapshot_entry (header, "tracks", path)) != num_tracks())
+          throw Exception ("SIFT checkpoint file \"" + path + "\" does not match the current model");
+
+        const int64_t expected_size = 8 + 4 * sizeof (double) + fixels.size() * sizeof (double) + snapshot_section_size ((num_tracks() + 7) / 8);
+        File::MMap mmap (File::Entry (path, offset));
+        const uint8_t* ptr = mmap.address();
+        check_snapshot_data (path, ptr, mmap.size(), expected_size);
+        ptr += 8;
+
+        const double* values = reinterpret_cast<const double*> (ptr);
+        TD_sum = values[0];
+        resume_init_cf = values[1];
+        resume_contributing_length_removed = values[2];
+        resume_noncontributing_length_removed = values[3];
+        resume_iteration = to<unsigned int> (get_snapshot_entry (header, "iteration", path));
+        enforce_quantisation = to<int> (get_snapshot_entry (header, "enforce_quantisation", path));
+
+        const double* TDs = values + 4;
+        for (size_t i = 0; i != fixels.size(); ++i) {
+          fixels[i].clear_TD();
+          fixels[i] += TDs[i];
         }
-        sort (output_at_counts.begin(), output_at_counts.end());
-        output_debug = b;
-      }
-
 
+        const uint8_t* removed = reinterpret_cast<const uint8_t*> (TDs + fixels.size());
+        track_t removed_count = 0;
+        for (track_t i = 0; i != num_tracks(); ++i) {
+          if ((removed[i/8] >> (i%8)) & 1) {
+            if (contributions[i]) {
+              delete contributions[i];
+              contributions[i] = NULL;
+            }
+            ++removed_count;
+          }
+        }
 
+        INFO ("Resuming filtering from iteration " + str (resume_iteration) + ", with " + str (removed_count) + " streamlines removed; proportionality coefficient is " + str (mu()));
+      }
 
-      void SIFTer::test_sorting_block_size (const size_t num_tracks) const
-      {
 
-        Math::RNG rng;
 
-        std::vector<Cost_fn_gradient_sort> gradient_vector;
-        gradient_vector.assign (num_tracks, Cost_fn_gradient_sort (num_tracks, 0.0, 0.0));
-        // Fill the gradient vector with random Gaussian data
-        for (track_t index = 0; index != num_tracks; ++index) {
-          const float value = rng.normal();
-          gradient_vector[index].set (index, value, value);
+      void SIFTer::save_checkpoint (const unsigned int iteration, const double init_cf, const double contributing_length_removed, const double noncontributing_length_removed) const
+      {
+        std::map<std::string, std::string> header;
+        header["fixels"] = str (fixels.size());
+        header["tracks"] = str (num_tracks());
+        header["iteration"] = str (iteration);
+        header["enforce_quantisation"] = str (int (enforce_quantisation));
+
+        BitSet removed (num_tracks());
+        for (track_t i = 0; i != num_tracks(); ++i)
+          removed[i] = !contributions[i];
+
+        std::vector<double> values;
+        values.push_back (TD_sum);
+        values.push_back (init_cf);
+        values.push_back (contributing_length_removed);
+        values.push_back (noncontributing_length_removed);
+        for (std::vector<Fixel>::const_iterator i = fixels.begin(); i != fixels.end(); ++i)
+          values.push_back (i->get_TD());
+
+        // Write to a temporary file and then rename, so that an interruption never leaves a partially-written checkpoint
+        const std::string temp_path = checkpoint_path + ".tmp";
+        {
+          // A temporary file left over from an interrupted run is of no use
+          if (Path::exists (temp_path))
+            File::unlink (temp_path);
+          File::OFStream out (temp_path, std::ios::out | std::ios::binary);
+          write_snapshot_header (out, "SIFT checkpoint", header);
+          write_snapshot_data (out, &values[0], values.size() * sizeof (double));
+          write_snapshot_data (out, removed.get_data_ptr(), (removed.size() + 7) / 8);
+          pad_snapshot_section (out, (removed.size() + 7) / 8);
         }
+        if (std::rename (temp_path.c_str(), checkpoint_path.c_str()))
+          throw Exception ("error updating SIFT checkpoint file \"" + checkpoint_path + "\": " + strerror (errno));
+      }
 
-        std::vector<size_t> block_sizes;
-        for (size_t i = 16; i < num_tracks; i *= 2)
-          block_sizes.push_back (i);
-        block_sizes.push_back (num_tracks);
-
-        for (std::vector<size_t>::const_iterator i = block_sizes.begin(); i != block_sizes.end(); ++i) {
-          const size_t block_size = *i;
-
-          // Make a copy of the gradient vector, so the same data is sorted each time
-          std::vector<Cost_fn_gradient_sort> temp_gv (gradient_vector);
-
-          Timer timer;
-          // Simulate sorting and filtering
-          try {
-            MT_gradient_vector_sorter sorter (temp_gv, block_size);
-            for (size_t candidate_count = 0; candidate_count < num_tracks / 1000; ++candidate_count)
-              sorter.get();
-            std::cerr << "Time required for sorting " << num_tracks << " tracks, block size " << block_size << " = " << timer.elapsed() * 1000.0 << "ms\n";
-          } catch (...) {
-            std::cerr << "Could not sort " << num_tracks << "tracks with block size " << block_size << "\n";
-          }
 
 
 
+      void SIFTer::set_regular_outputs (const std::vector<int>& in, const bool b)
+      {
+        for (std::vector<int>::const_iterator i = in.begin(); i != in.end(); ++i) {
+          if (*i > 0 && *i <= (int)contributions.size())
+            output_at_counts.push_back (*i);
         }
-
+        sort (output_at_counts.begin(), output_at_counts.end());
+        output_at_counts.erase (std::unique (output_at_counts.begin(), output_at_counts.end()), output_at_counts.end());
+        output_debug = b;
       }
 
 
 
 
-
-
       // Convenience functions
 
       double SIFTer::calc_roc_cost_function() const
@@ -437,18 +538,28 @@ namespace MR
 
       bool SIFTer::TrackGradientCalculator::operator() (const TrackIndexRange& in) const
       {
-        for (track_t track_index = in.first; track_index != in.second; ++track_index) {
-          if (master.contributions[track_index]) {
-            const double gradient = master.calc_gradient (track_index, current_mu, current_roc_cost);
-            const double grad_per_unit_length = master.contributions[track_index]->get_total_contribution() ? (gradient / master.contributions[track_index]->get_total_contribution()) : 0.0;
-            gradient_vector[track_index].set (track_index, gradient, grad_per_unit_length);
-          } else {
-            gradient_vector[track_index].set (master.num_tracks(), 0.0, 0.0);
-          }
+        if (subset) {
+          for (track_t i = in.first; i != in.second; ++i)
+            calculate ((*subset)[i]);
+        } else {
+          for (track_t track_index = in.first; track_index != in.second; ++track_index)
+            calculate (track_index);
         }
         return true;
       }
 
+      void SIFTer::TrackGradientCalculator::calculate (const track_t track_index) const
+      {
+        // Removed streamlines retain their own index, so that the gradient vector can be restored to streamline order after sorting
+        if (master.contributions[track_index]) {
+          const double gradient = master.calc_gradient (track_index, current_mu, current_roc_cost);
+          const double grad_per_unit_length = master.contributions[track_index]->get_total_contribution() ? (gradient / master.contributions[track_index]->get_total_contribution()) : 0.0;
+          gradient_vector[track_index].set (track_index, gradient, grad_per_unit_length);
+        } else {
+          gradient_vector[track_index].set (track_index, 0.0, 0.0);
+        }
+      }
+
 
 
 
@@ -34,6 +34,7 @@
 #include "dwi/directions/set.h"
 
 #include "dwi/tractography/SIFT/fixel.h"
+#include "dwi/tractography/SIFT/fixel_track_index.h"
 #include "dwi/tractography/SIFT/gradient_sort.h"
 #include "dwi/tractography/SIFT/model.h"
 #include "dwi/tractography/SIFT/output.h"
@@ -71,7 +72,12 @@ namespace MR
             term_number (0),
             term_ratio (0.0),
             term_mu (0.0),
-            enforce_quantisation (true) { }
+            enforce_quantisation (true),
+            incremental_gradients (false),
+            resume_iteration (0),
+            resume_init_cf (0.0),
+            resume_contributing_length_removed (0.0),
+            resume_noncontributing_length_removed (0.0) { }
 
         ~SIFTer() { }
 
@@ -86,12 +92,15 @@ namespace MR
         void set_term_ratio  (const float i)        { term_ratio = i; }
         void set_term_mu     (const float i)        { term_mu = i; }
         void set_csv_path    (const std::string& i) { csv_path = i; }
+        void set_incremental_gradients (const bool i) { incremental_gradients = i; }
+        void set_checkpoint_path (const std::string& i) { checkpoint_path = i; }
 
-        void set_regular_outputs (const std::vector<int>&, const bool);
-
+        // CHECKPOINTING
+        // The filtering state is written to the checkpoint file (if set) at the end of every iteration;
+        //   loading it into a model constructed from the same data resumes filtering from that point
+        void load_checkpoint (const std::string&);
 
-        // DEBUGGING
-        void test_sorting_block_size (const size_t) const;
+        void set_regular_outputs (const std::vector<int>&, const bool);
 
 
         protected:
@@ -113,26 +122,37 @@ namespace MR
         float   term_ratio;
         double  term_mu;
         bool    enforce_quantisation;
+        bool    incremental_gradients;
         std::string csv_path;
+        std::string checkpoint_path;
+
+        // Filtering state restored from a checkpoint
+        unsigned int resume_iteration;
+        double  resume_init_cf, resume_contributing_length_removed, resume_noncontributing_length_removed;
 
 
         // Convenience functions
         double calc_roc_cost_function() const;
         double calc_gradient (const track_t, const double, const double) const;
+        void   save_checkpoint (const unsigned int, const double, const double, const double) const;
 
 
 
         // For calculating the streamline removal gradients in a multi-threaded fashion
+        // If a subset of streamline indices is provided, the input ranges index into that subset rather
+        //   than the full set of streamlines; this is used for incremental gradient updates
         class TrackGradientCalculator
         {
           public:
-            TrackGradientCalculator (const SIFTer& sifter, std::vector<Cost_fn_gradient_sort>& v, const double mu, const double r) :
-              master (sifter), gradient_vector (v), current_mu (mu), current_roc_cost (r) { }
+            TrackGradientCalculator (const SIFTer& sifter, std::vector<Cost_fn_gradient_sort>& v, const double mu, const double r, const std::vector<track_t>* s = NULL) :
+              master (sifter), gradient_vector (v), current_mu (mu), current_roc_cost (r), subset (s) { }
             bool operator() (const TrackIndexRange&) const;
           private:
             const SIFTer& master;
             std::vector<Cost_fn_gradient_sort>& gradient_vector;
             const double current_mu, current_roc_cost;
+            const std::vector<track_t>* subset;
+            void calculate (const track_t) const;
         };
 
 
@@ -143,7 +163,12 @@ namespace MR
             term_number (0),
             term_ratio (0.0),
             term_mu (0.0),
-            enforce_quantisation (true) { assert (0); }
+            enforce_quantisation (true),
+            incremental_gradients (false),
+            resume_iteration (0),
+            resume_init_cf (0.0),
+            resume_contributing_length_removed (0.0),
+            resume_noncontributing_length_removed (0.0) { assert (0); }
 
 
       };
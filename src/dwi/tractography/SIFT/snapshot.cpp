@@ -0,0 +1,123 @@
+/*
+    Copyright 2014 Brain Research Institute, Melbourne, Australia
+
+    Written by Robert E. Smith, 2014.
+
+    This file is part of MRtrix.
+
+    MRtrix is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    MRtrix is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with MRtrix.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#include "dwi/tractography/SIFT/snapshot.h"
+
+#include "exception.h"
+#include "mrtrix.h"
+
+#include "file/key_value.h"
+#include "file/path.h"
+
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+      namespace SIFT
+      {
+
+
+
+      int64_t write_snapshot_header (std::ofstream& out, const std::string& type, const std::map<std::string, std::string>& entries)
+      {
+        out << "mrtrix " << type << "\n";
+        for (std::map<std::string, std::string>::const_iterator i = entries.begin(); i != entries.end(); ++i)
+          out << i->first << ": " << i->second << "\n";
+        int64_t data_offset = int64_t(out.tellp()) + 32;
+        data_offset += (8 - (data_offset % 8)) % 8;
+        out << "file: . " << data_offset << "\nEND\n";
+        if (int64_t(out.tellp()) > data_offset)
+          throw Exception ("error writing " + type + " file header");
+        out.seekp (data_offset);
+        const uint32_t check[2] = { SIFT_SNAPSHOT_CHECK_WORD, 0 };
+        write_snapshot_data (out, check, sizeof (check));
+        return data_offset;
+      }
+
+
+
+      int64_t read_snapshot_header (const std::string& path, const std::string& type, std::map<std::string, std::string>& entries)
+      {
+        entries.clear();
+        const std::string firstline ("mrtrix " + type);
+        File::KeyValue kv (path, firstline.c_str());
+        std::string data_file;
+        while (kv.next()) {
+          const std::string key = lowercase (kv.key());
+          if (key == "file")
+            data_file = kv.value();
+          else
+            entries[key] = kv.value();
+        }
+        if (data_file.empty())
+          throw Exception ("missing \"file\" specification for " + type + " file \"" + path + "\"");
+        std::vector<std::string> V (split (data_file, " \t", true));
+        if (V.size() != 2 || V[0] != ".")
+          throw Exception ("invalid \"file\" specification for " + type + " file \"" + path + "\"");
+        return to<int64_t> (V[1]);
+      }
+
+
+
+      void check_snapshot_data (const std::string& path, const uint8_t* data, const int64_t size, const int64_t expected_size)
+      {
+        if (size != expected_size)
+          throw Exception ("file \"" + path + "\" is of unexpected size (" + str(size) + " bytes of data, expected " + str(expected_size) + ")");
+        if (*reinterpret_cast<const uint32_t*> (data) != SIFT_SNAPSHOT_CHECK_WORD)
+          throw Exception ("file \"" + path + "\" was written on a system with different byte order, or is corrupt");
+      }
+
+
+
+      void write_snapshot_data (std::ofstream& out, const void* data, const size_t bytes)
+      {
+        out.write (reinterpret_cast<const char*> (data), bytes);
+        if (!out.good())
+          throw Exception ("error writing snapshot file: " + std::string (strerror (errno)));
+      }
+
+      void pad_snapshot_section (std::ofstream& out, const size_t bytes)
+      {
+        const char zeros[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+        write_snapshot_data (out, zeros, snapshot_section_size (bytes) - bytes);
+      }
+
+
+
+      const std::string& get_snapshot_entry (const std::map<std::string, std::string>& entries, const std::string& key, const std::string& path)
+      {
+        std::map<std::string, std::string>::const_iterator i = entries.find (key);
+        if (i == entries.end())
+          throw Exception ("missing \"" + key + "\" entry in file \"" + path + "\"");
+        return i->second;
+      }
+
+
+
+      }
+    }
+  }
+}
@@ -0,0 +1,94 @@
+/*
+    Copyright 2014 Brain Research Institute, Melbourne, Australia
+
+    Written by Robert E. Smith, 2014.
+
+    This file is part of MRtrix.
+
+    MRtrix is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    MRtrix is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with MRtrix.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+
+#ifndef __dwi_tractography_sift_snapshot_h__
+#define __dwi_tractography_sift_snapshot_h__
+
+
+#include <fstream>
+#include <map>
+#include <stdint.h>
+#include <string>
+
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+      namespace SIFT
+      {
+
+
+
+      // Binary snapshot files for checkpointing SIFT
+      // These follow the format of other MRtrix3 files: a text header of key-value pairs (the first line identifying
+      //   the file type), terminated by 'END', with the binary data located at the byte offset given in the 'file' entry.
+      //   Data are stored in native byte order, with sections aligned to 8 bytes, so that the binary portion of the file
+      //   can be accessed directly using File::MMap; a check word at the start of the data guards against reading a
+      //   snapshot written on a machine with different byte order.
+
+#define SIFT_SNAPSHOT_CHECK_WORD 0x53494654
+
+
+
+      // Fixel data as stored in a model snapshot
+      struct SnapshotFixel
+      {
+        double FOD, TD;
+        float  weight;
+        float  dir[3];
+      };
+
+
+
+      // Writes the header, and positions the stream at the start of the binary data (the check word is written
+      //   automatically); returns the byte offset of the binary data
+      int64_t write_snapshot_header (std::ofstream&, const std::string& type, const std::map<std::string, std::string>&);
+
+      // Reads the header; returns the byte offset of the binary data
+      int64_t read_snapshot_header  (const std::string& path, const std::string& type, std::map<std::string, std::string>&);
+
+      // Verifies the check word at the start of the mapped binary data, and that the data are of the expected size
+      void    check_snapshot_data   (const std::string& path, const uint8_t* data, const int64_t size, const int64_t expected_size);
+
+      // Convenience functions for writing raw data, padding each section to a multiple of 8 bytes
+      void    write_snapshot_data   (std::ofstream&, const void* data, const size_t bytes);
+      void    pad_snapshot_section  (std::ofstream&, const size_t bytes);
+
+      inline size_t snapshot_section_size (const size_t bytes) { return bytes + ((8 - (bytes % 8)) % 8); }
+
+      // Helper for looking up mandatory header entries
+      const std::string& get_snapshot_entry (const std::map<std::string, std::string>&, const std::string& key, const std::string& path);
+
+
+
+      }
+    }
+  }
+}
+
+
+#endif
@@ -243,6 +243,8 @@ namespace MR
 
       value_type FOD (const Point<value_type>& d) const
       {
+        ProfileScope timer (profile, PROFILE_SH);
+        if (profile) profile->add (PROFILE_SH_EVALUATIONS);
         return (S.precomputer ?
             S.precomputer.value (values, d) :
             Math::SH::value (values, d, S.lmax)
@@ -352,6 +352,8 @@ end_init:
 
             value_type FOD (const Point<value_type>& direction) const
             {
+              ProfileScope timer (profile, PROFILE_SH);
+              if (profile) profile->add (PROFILE_SH_EVALUATIONS);
               return (S.precomputer ?
                   S.precomputer.value (values, direction) :
                   Math::SH::value (values, direction, S.lmax)
@@ -150,6 +150,8 @@ class SDStream : public MethodBase {
 
       value_type find_peak ()
       {
+        ProfileScope timer (profile, PROFILE_SH);
+        if (profile) profile->add (PROFILE_SH_EVALUATIONS);
         value_type FOD = Math::SH::get_peak (&values[0], S.lmax, dir, S.precomputer);
         if (!std::isfinite (FOD) || FOD < S.threshold)
           FOD = 0.0;
@@ -158,6 +160,8 @@ class SDStream : public MethodBase {
 
       value_type FOD (const Point<value_type>& d) const
       {
+        ProfileScope timer (profile, PROFILE_SH);
+        if (profile) profile->add (PROFILE_SH_EVALUATIONS);
         return (S.precomputer ?
             S.precomputer->value (values, d) :
             Math::SH::value (values, d, S.lmax)
@@ -0,0 +1,175 @@
+/*
+    Copyright 2014 Brain Research Institute, Melbourne, Australia
+
+    Written by Robert E. Smith, 2014.
+
+    This file is part of MRtrix.
+
+    MRtrix is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    MRtrix is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with MRtrix.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef __dwi_tractography_compact_encoding_h__
+#define __dwi_tractography_compact_encoding_h__
+
+#include <istream>
+#include <vector>
+
+#include "point.h"
+#include "types.h"
+
+
+// Interval (in tracks) between entries of the offset index appended to
+// compact track files
+#define TRACK_COMPACT_INDEX_INTERVAL 1024
+// Marks the end of the offset index; also the last 4 bytes of the file
+#define TRACK_COMPACT_INDEX_MAGIC "TCQI"
+
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+
+
+
+      //! the compact (quantised, delta-encoded) track data encoding
+      /*! In this encoding, point coordinates are quantised to integer
+       * multiples of \a step relative to \a origin. Both are stored in the
+       * file header; the Writer currently always uses an origin of zero
+       * (since the header is written before any track data are known), so
+       * that points are quantised on a fixed scanner-space grid, but readers
+       * honour any origin present in the header. The first point of each
+       * track is stored in full, and each subsequent point as its difference
+       * from the previous one. All values are stored as variable-length
+       * integers (LEB128, with zig-zag encoding for signed values), so that
+       * the small differences between successive points typically occupy one
+       * or two bytes per coordinate. Each track is preceded by its number of
+       * points; a zero entry marks the end of the data.
+       *
+       * Once writing is complete, an offset index is appended after the end
+       * of the data: the file offset of every TRACK_COMPACT_INDEX_INTERVAL'th
+       * track (as 64-bit little-endian integers), followed by the number of
+       * entries (64-bit), the interval (32-bit), and TRACK_COMPACT_INDEX_MAGIC. */
+      class CompactEncoding
+      {
+        public:
+          CompactEncoding () : step (0.0), origin (0.0, 0.0, 0.0) { }
+
+          bool active () const { return step > 0.0; }
+
+          float step;
+          Point<float> origin;
+
+
+          //! append the encoded form of the track in \a data to \a out
+          template <typename ValueType>
+            void encode (const Point<ValueType>* data, size_t num_points, std::vector<uint8_t>& out) const
+            {
+              put (num_points, out);
+              int64_t prev[3] = { 0, 0, 0 };
+              for (size_t n = 0; n < num_points; ++n) {
+                for (size_t axis = 0; axis < 3; ++axis) {
+                  const int64_t q = quantise (data[n][axis], axis);
+                  put_signed (q - prev[axis], out);
+                  prev[axis] = q;
+                }
+              }
+            }
+
+          //! decode the next track from \a in
+          /*! returns false at the end of the data, or if the stream fails. */
+          template <typename ValueType>
+            bool decode (std::istream& in, std::vector< Point<ValueType> >& tck) const
+            {
+              uint64_t num_points;
+              if (!get (in, num_points) || !num_points)
+                return false;
+              tck.resize (num_points);
+              int64_t q[3] = { 0, 0, 0 };
+              for (size_t n = 0; n < num_points; ++n) {
+                for (size_t axis = 0; axis < 3; ++axis) {
+                  int64_t delta;
+                  if (!get_signed (in, delta))
+                    return false;
+                  q[axis] += delta;
+                  tck[n][axis] = ValueType (origin[axis] + step * q[axis]);
+                }
+              }
+              return true;
+            }
+
+          //! skip over the next track in \a in
+          bool skip (std::istream& in) const
+          {
+            uint64_t num_points, value;
+            if (!get (in, num_points) || !num_points)
+              return false;
+            for (size_t n = 0; n < 3*num_points; ++n)
+              if (!get (in, value))
+                return false;
+            return true;
+          }
+
+
+        private:
+          template <typename ValueType>
+            int64_t quantise (ValueType value, size_t axis) const {
+              return int64_t (std::floor ((value - origin[axis]) / step + 0.5));
+            }
+
+          static void put (uint64_t value, std::vector<uint8_t>& out) {
+            while (value >= 0x80) {
+              out.push_back (uint8_t (value | 0x80));
+              value >>= 7;
+            }
+            out.push_back (uint8_t (value));
+          }
+
+          static void put_signed (int64_t value, std::vector<uint8_t>& out) {
+            put ((uint64_t (value) << 1) ^ uint64_t (value >> 63), out);
+          }
+
+          static bool get (std::istream& in, uint64_t& value) {
+            value = 0;
+            for (size_t shift = 0; shift < 64; shift += 7) {
+              const int c = in.get();
+              if (c == EOF)
+                return false;
+              value |= uint64_t (c & 0x7F) << shift;
+              if (!(c & 0x80))
+                return true;
+            }
+            return false;
+          }
+
+          static bool get_signed (std::istream& in, int64_t& value) {
+            uint64_t u;
+            if (!get (in, u))
+              return false;
+            value = int64_t (u >> 1) ^ -int64_t (u & 1);
+            return true;
+          }
+      };
+
+
+
+    }
+  }
+}
+
+#endif
+
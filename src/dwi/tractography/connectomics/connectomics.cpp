@@ -54,6 +54,12 @@ const OptionGroup AssignmentOption = OptionGroup ("Structural connectome streaml
                                         "Argument is the maximum radius in mm; if no node is found within this radius, the streamline endpoint is not assigned to any node. ")
     + Argument ("radius").type_float (0.0, TCK2NODES_RADIAL_DEFAULT_DIST, 1e6)
 
+  + Option ("assignment_radial_supersample", "compute the nearest node to each location at a finer resolution than the parcellation image "
+                                             "for the radial search assignment mechanism, by the specified factor along each axis; this does not "
+                                             "alter the result, but tightens the bounds on the distance to the nearest node, reducing the number of "
+                                             "voxels tested per endpoint at the expense of memory (must be an odd integer; default = 1)")
+    + Argument ("factor").type_integer (1, 1, 15)
+
   + Option ("assignment_reverse_search", "traverse from each streamline endpoint inwards along the streamline, in search of the last node traversed by the streamline. "
                                          "Argument is the maximum traversal length in mm (set to 0 to allow search to continue to the streamline midpoint).")
     + Argument ("max_dist").type_float (0.0, TCK2NODES_REVSEARCH_DEFAULT_DIST, 1e6)
@@ -68,6 +74,9 @@ const OptionGroup AssignmentOption = OptionGroup ("Structural connectome streaml
 Tck2nodes_base* load_assignment_mode (Image::Buffer<node_t>& nodes_data)
 {
 
+  Options supersample_opt = get_options ("assignment_radial_supersample");
+  const size_t supersample = supersample_opt.size() ? int(supersample_opt[0][0]) : 1;
+
   Tck2nodes_base* tck2nodes = NULL;
   for (size_t index = 0; modes[index]; ++index) {
     Options opt = get_options (modes[index]);
@@ -81,7 +90,7 @@ Tck2nodes_base* load_assignment_mode (Image::Buffer<node_t>& nodes_data)
 
       switch (index) {
         case 0: tck2nodes = new Connectomics::Tck2nodes_voxel (nodes_data); break;
-        case 1: tck2nodes = new Connectomics::Tck2nodes_radial (nodes_data, float(opt[0][0])); break;
+        case 1: tck2nodes = new Connectomics::Tck2nodes_radial (nodes_data, float(opt[0][0]), supersample); break;
         case 2: tck2nodes = new Connectomics::Tck2nodes_revsearch (nodes_data, float(opt[0][0])); break;
         case 3: tck2nodes = new Connectomics::Tck2nodes_forwardsearch (nodes_data, float(opt[0][0])); break;
       }
@@ -91,7 +100,7 @@ Tck2nodes_base* load_assignment_mode (Image::Buffer<node_t>& nodes_data)
 
   // default
   if (!tck2nodes)
-    tck2nodes = new Connectomics::Tck2nodes_radial (nodes_data, TCK2NODES_RADIAL_DEFAULT_DIST);
+    tck2nodes = new Connectomics::Tck2nodes_radial (nodes_data, TCK2NODES_RADIAL_DEFAULT_DIST, supersample);
 
   return tck2nodes;
 
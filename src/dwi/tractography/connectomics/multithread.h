@@ -34,6 +34,7 @@
 #include "dwi/tractography/file.h"
 #include "dwi/tractography/properties.h"
 #include "dwi/tractography/streamline.h"
+#include "dwi/tractography/writer_pool.h"
 #include "dwi/tractography/connectomics/connectomics.h"
 #include "dwi/tractography/connectomics/edge_metrics.h"
 #include "dwi/tractography/connectomics/tck2nodes.h"
@@ -281,53 +282,37 @@ class NodeExtractWriter
     };
 
     NodeExtractWriter (const Tractography::Properties& p) :
-      properties (p) { }
-
-    ~NodeExtractWriter()
-    {
-      for (size_t i = 0; i != writers.size(); ++i) {
-        delete writers[i];
-        writers[i] = NULL;
-      }
-    }
+      writers (p) { }
 
 
     void add (const node_t node, const std::string& path, const std::string weights_path = "")
     {
       nodes.push_back (NodeSelector (node));
-      writers.push_back (new Tractography::WriterUnbuffered<float> (path, properties));
-      if (weights_path.size())
-        writers.back()->set_weights_path (weights_path);
+      writers.add (path, weights_path);
     }
 
     void add (const node_t node_one, const node_t node_two, const std::string& path, const std::string weights_path = "")
     {
       nodes.push_back (NodeSelector (node_one, node_two));
-      writers.push_back (new Tractography::WriterUnbuffered<float> (path, properties));
-      if (weights_path.size())
-        writers.back()->set_weights_path (weights_path);
+      writers.add (path, weights_path);
     }
 
     void clear()
     {
       nodes.clear();
-      for (size_t i = 0; i != writers.size(); ++i) {
-        delete writers[i];
-        writers[i] = NULL;
-      }
-      writers.clear();
+      writers.close();
     }
 
 
-    bool operator() (const MappedTrackWithData& in) const
+    bool operator() (const MappedTrackWithData& in)
     {
       for (size_t i = 0; i != file_count(); ++i) {
         if (nodes[i] (in)) {
           Tractography::Streamline<float> temp (in.tck);
           temp.weight = in.get_weight();
-          (*writers[i]) (temp);
+          writers (i, temp);
         } else {
-          (*writers[i]) (empty_tck);
+          writers (i, empty_tck);
         }
       }
       return true;
@@ -338,10 +323,9 @@ class NodeExtractWriter
 
 
   private:
-    Tractography::Properties properties;
     std::vector< NodeSelector > nodes;
-    std::vector< Tractography::WriterUnbuffered<float>* > writers;
-    std::vector< Point<float> > empty_tck;
+    Tractography::WriterPool<float> writers;
+    Tractography::Streamline<float> empty_tck;
 
 };
 
@@ -0,0 +1,136 @@
+/*
+    Copyright 2014 Brain Research Institute, Melbourne, Australia
+
+    Written by Robert E. Smith, 2014.
+
+    This file is part of MRtrix.
+
+    MRtrix is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    MRtrix is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with MRtrix.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#include "dwi/tractography/connectomics/nearest_node.h"
+
+#include <algorithm>
+
+#include "math/math.h"
+#include "image/loop.h"
+#include "image/voxel.h"
+#include "image/filter/distance_transform.h"
+
+
+namespace MR {
+namespace DWI {
+namespace Tractography {
+namespace Connectomics {
+
+
+
+const uint32_t NearestNodeMap::none;
+
+
+
+NearestNodeMap::NearestNodeMap (Image::Buffer<node_t>& nodes_data, const size_t supersample) :
+    transform (nodes_data),
+    factor (supersample)
+{
+  if (!(factor % 2))
+    throw Exception ("Supersampling factor for nearest node map must be odd");
+
+  for (size_t axis = 0; axis != 3; ++axis) {
+    vox[axis] = nodes_data.vox (axis);
+    node_dim[axis] = nodes_data.dim (axis);
+    dim[axis] = node_dim[axis] * factor;
+  }
+  if (dim[0] * dim[1] * dim[2] >= size_t (none))
+    throw Exception ("Parcellation image too large to compute nearest node map at supersampling factor " + str(factor));
+
+  std::vector<float> dist2 (dim[0] * dim[1] * dim[2], std::numeric_limits<float>::infinity());
+  nearest.assign (dist2.size(), none);
+
+  // Seed the transform with the centres of those voxels with a non-zero node index
+  const size_t centre = (factor - 1) / 2;
+  Image::Buffer<node_t>::voxel_type voxel (nodes_data);
+  Image::Loop loop (0, 3);
+  for (auto l = loop (voxel); l; ++l) {
+    const node_t node = voxel.value();
+    if (node) {
+      const size_t index = voxel[0] + node_dim[0] * (voxel[1] + node_dim[1] * voxel[2]);
+      const size_t g = grid_index (voxel[0]*factor + centre, voxel[1]*factor + centre, voxel[2]*factor + centre);
+      dist2[g] = 0.0;
+      nearest[g] = index;
+    }
+  }
+
+  std::vector<size_t> grid_dim (dim, dim + 3);
+  std::vector<float> spacing (3);
+  for (size_t axis = 0; axis != 3; ++axis)
+    spacing[axis] = nodes_data.vox (axis) / float(factor);
+  Image::Filter::distance_transform (dist2, &nearest, grid_dim, spacing);
+}
+
+
+
+
+void NearestNodeMap::bounds (const Point<float>& p, float& lower, float& upper) const
+{
+
+  // Continuous position of the point on the supersampled grid
+  const Point<float> v (transform.scanner2voxel (p));
+  int lower_corner[3];
+  for (size_t axis = 0; axis != 3; ++axis)
+    lower_corner[axis] = std::floor ((v[axis] + 0.5) * factor - 0.5);
+
+  // Every grid point g provides both a node voxel at a known distance from p
+  //   (an upper bound), and, since its nearest node voxel is at distance D(g)
+  //   from g, a lower bound of D(g) - |p - g| by the triangle inequality.
+  // Grid points are clamped to the image; the bounds remain valid regardless.
+  lower = 0.0;
+  upper = std::numeric_limits<float>::infinity();
+  for (size_t corner = 0; corner != 8; ++corner) {
+
+    size_t g[3];
+    for (size_t axis = 0; axis != 3; ++axis)
+      g[axis] = std::min (std::max (lower_corner[axis] + int((corner >> axis) & 1), 0), int(dim[axis]) - 1);
+    const uint32_t index = nearest[grid_index (g[0], g[1], g[2])];
+    if (index == none) {
+      // No node voxels anywhere in the image
+      lower = upper = std::numeric_limits<float>::infinity();
+      return;
+    }
+
+    const size_t node_voxel[3] = { index % node_dim[0], (index / node_dim[0]) % node_dim[1], index / (node_dim[0] * node_dim[1]) };
+    float grid_to_node = 0.0, grid_to_point = 0.0, point_to_node = 0.0;
+    for (size_t axis = 0; axis != 3; ++axis) {
+      const float grid_pos = (g[axis] + 0.5) / float(factor) - 0.5;
+      grid_to_node  += Math::pow2 ((grid_pos - node_voxel[axis]) * vox[axis]);
+      grid_to_point += Math::pow2 ((grid_pos - v[axis]) * vox[axis]);
+      point_to_node += Math::pow2 ((v[axis] - node_voxel[axis]) * vox[axis]);
+    }
+    lower = std::max (lower, std::sqrt (grid_to_node) - std::sqrt (grid_to_point));
+    upper = std::min (upper, std::sqrt (point_to_node));
+
+  }
+
+}
+
+
+
+
+}
+}
+}
+}
+
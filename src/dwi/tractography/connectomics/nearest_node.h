@@ -0,0 +1,92 @@
+/*
+    Copyright 2014 Brain Research Institute, Melbourne, Australia
+
+    Written by Robert E. Smith, 2014.
+
+    This file is part of MRtrix.
+
+    MRtrix is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    MRtrix is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with MRtrix.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+
+#ifndef __dwi_tractography_connectomics_nearest_node_h__
+#define __dwi_tractography_connectomics_nearest_node_h__
+
+
+#include <stdint.h>
+#include <vector>
+
+#include "point.h"
+
+#include "image/buffer.h"
+#include "image/transform.h"
+
+#include "dwi/tractography/connectomics/connectomics.h"
+
+
+namespace MR {
+namespace DWI {
+namespace Tractography {
+namespace Connectomics {
+
+
+
+// Labelled Euclidean distance transform of a parcellation image:
+//   for each point on a (optionally supersampled) grid, stores the index of the
+//   parcellation voxel with non-zero node index whose centre is nearest.
+// This allows the distance from a streamline endpoint to the nearest node voxel
+//   to be bounded from the nearest node voxels of the eight surrounding grid
+//   points, so that the radial search only needs to test the few voxels within
+//   that distance, rather than walking outwards through the image.
+// The supersampling factor must be odd, so that every parcellation voxel centre
+//   lies exactly on a grid point and the transform is exact at grid points;
+//   larger factors give tighter bounds.
+class NearestNodeMap {
+
+  public:
+    NearestNodeMap (Image::Buffer<node_t>& nodes_data, const size_t supersample = 1);
+
+    // Bound the distance from scanner-space point p to the nearest voxel centre
+    //   with non-zero node index: upper is the distance to one such voxel
+    //   (infinity if the image contains no nodes), and lower can only exceed
+    //   the true distance through floating-point rounding
+    void bounds (const Point<float>& p, float& lower, float& upper) const;
+
+    size_t supersample () const { return factor; }
+
+  private:
+    Image::Transform transform;
+    const size_t factor;
+    float vox[3];
+    size_t node_dim[3], dim[3];
+    std::vector<uint32_t> nearest;
+
+    static const uint32_t none = std::numeric_limits<uint32_t>::max();
+
+    size_t grid_index (const size_t i, const size_t j, const size_t k) const { return i + dim[0] * (j + dim[1] * k); }
+
+};
+
+
+
+}
+}
+}
+}
+
+
+#endif
+
@@ -56,7 +56,7 @@ void Tck2nodes_radial::initialise_search ()
   for (offset[2] = -max_axis_offset; offset[2] <= +max_axis_offset; ++offset[2]) {
     for (offset[1] = -max_axis_offset; offset[1] <= +max_axis_offset; ++offset[1]) {
       for (offset[0] = -max_axis_offset; offset[0] <= +max_axis_offset; ++offset[0]) {
-        const float dist = std::sqrt (Math::pow2 (offset[2] * nodes.vox(2)) + Math::pow2 (offset[1] * nodes.vox(1)) + Math::pow2 (offset[0] * nodes.vox(0)));
+        const float dist = offset_distance (offset);
         if (dist < (max_dist + max_add_dist))
           radial_search_map.insert (std::make_pair (dist, offset));
       }
@@ -73,12 +73,77 @@ void Tck2nodes_radial::initialise_search ()
 
 
 node_t Tck2nodes_radial::select_node (const Streamline<>& tck, VoxelType& voxel, bool end) const
+{
+
+  const Point<float>& p (end ? tck.back() : tck.front());
+
+  float lower, upper;
+  nearest_node->bounds (p, lower, upper);
+  // Allow for rounding errors in the bounds, so that no node voxel within range is missed
+  const float tolerance = 1e-3 * (max_dist + max_add_dist);
+  if (lower - tolerance >= max_dist)
+    return 0;
+  const float radius = std::min (upper, max_dist) + tolerance;
+
+  // Test every voxel that could lie within that radius of the endpoint, selecting the
+  //   closest; ties are broken as in the exhaustive search, which tests voxels in
+  //   order of increasing offset distance, then in lexicographical order of offset
+  const Point<float> v_float = transform.scanner2voxel (p);
+  const Point<int> v (std::round (v_float[0]), std::round (v_float[1]), std::round (v_float[2]));
+  int from[3], to[3];
+  for (size_t axis = 0; axis != 3; ++axis) {
+    const float extent = radius / nodes.vox (axis);
+    from[axis] = std::max (int (std::floor (v_float[axis] - extent)), 0);
+    to[axis]   = std::min (int (std::ceil  (v_float[axis] + extent)), nodes.dim (axis) - 1);
+  }
+
+  node_t node = 0;
+  float min_dist = max_dist, min_offset_dist = 0.0;
+  Point<int> min_offset;
+  Point<int> this_voxel;
+  for (this_voxel[2] = from[2]; this_voxel[2] <= to[2]; ++this_voxel[2]) {
+    for (this_voxel[1] = from[1]; this_voxel[1] <= to[1]; ++this_voxel[1]) {
+      for (this_voxel[0] = from[0]; this_voxel[0] <= to[0]; ++this_voxel[0]) {
+        const node_t this_node = Image::Nav::get_value_at_pos (voxel, this_voxel);
+        if (!this_node)
+          continue;
+        const float dist ((p - transform.voxel2scanner (this_voxel)).norm());
+        if (dist > min_dist || (!node && dist == min_dist))
+          continue;
+        const Point<int> offset (this_voxel - v);
+        const float this_offset_dist = offset_distance (offset);
+        // Voxels are visited here in the same lexicographical order as the offsets
+        //   within the exhaustive search, so only the offset distance can reverse a tie
+        if (node && dist == min_dist && this_offset_dist >= min_offset_dist)
+          continue;
+        node = this_node;
+        min_dist = dist;
+        min_offset = offset;
+        min_offset_dist = this_offset_dist;
+      }
+    }
+  }
+
+  // The exhaustive search stops at the first offset whose voxel lies further than
+  //   (max_dist + max_add_dist) from the endpoint; such an offset must itself lie further
+  //   than max_dist from the rounded endpoint position. The result above can therefore
+  //   only differ from that of the exhaustive search if its offset lies beyond max_dist,
+  //   or if the bounds were too inaccurate for the nearest voxel to be found.
+  if (node ? (min_offset_dist > max_dist) : (upper < max_dist))
+    return exhaustive_search (p, voxel);
+  return node;
+
+}
+
+
+
+
+node_t Tck2nodes_radial::exhaustive_search (const Point<float>& p, VoxelType& voxel) const
 {
 
   float min_dist = max_dist;
   node_t node = 0;
 
-  const Point<float>& p (end ? tck.back() : tck.front());
   const Point<float> v_float = transform.scanner2voxel (p);
   const Point<int> v (std::round (v_float[0]), std::round (v_float[1]), std::round (v_float[2]));
 
@@ -44,6 +44,7 @@
 #include "dwi/tractography/streamline.h"
 
 #include "dwi/tractography/connectomics/connectomics.h"
+#include "dwi/tractography/connectomics/nearest_node.h"
 
 
 namespace MR {
@@ -121,8 +122,9 @@ class Tck2nodes_voxel : public Tck2nodes_base {
 class Tck2nodes_radial : public Tck2nodes_base {
 
   public:
-    Tck2nodes_radial (Image::Buffer<node_t>& nodes_data, const float radius) :
+    Tck2nodes_radial (Image::Buffer<node_t>& nodes_data, const float radius, const size_t supersample = 1) :
       Tck2nodes_base (nodes_data),
+      nearest_node   (new NearestNodeMap (nodes_data, supersample)),
       max_dist       (radius),
       max_add_dist   (std::sqrt (Math::pow2 (0.5 * nodes.vox(2)) + Math::pow2 (0.5 * nodes.vox(1)) + Math::pow2 (0.5 * nodes.vox(0))))
     {
@@ -131,6 +133,7 @@ class Tck2nodes_radial : public Tck2nodes_base {
 
     Tck2nodes_radial (const Tck2nodes_radial& that) :
       Tck2nodes_base (that),
+      nearest_node   (that.nearest_node),
       radial_search  (that.radial_search),
       max_dist       (that.max_dist),
       max_add_dist   (that.max_add_dist) { }
@@ -140,7 +143,20 @@ class Tck2nodes_radial : public Tck2nodes_base {
   private:
     node_t select_node (const Streamline<>& tck, VoxelType& voxel, bool end) const;
 
+    // Rather than searching outwards from each streamline endpoint, the nearest node
+    //   voxel to every point in the image is computed once, and shared between threads;
+    //   this bounds the distance to the nearest node, so that only the few voxels within
+    //   that distance need to be tested
+    RefPtr<NearestNodeMap> nearest_node;
+
+    // The exhaustive radial search order is retained, both to define how ties between
+    //   equidistant voxels are broken, and as a fallback for the rare endpoints where
+    //   its early termination could influence the result
     void initialise_search ();
+    float offset_distance (const Point<int>& offset) const {
+      return std::sqrt (Math::pow2 (offset[2] * nodes.vox(2)) + Math::pow2 (offset[1] * nodes.vox(1)) + Math::pow2 (offset[0] * nodes.vox(0)));
+    }
+    node_t exhaustive_search (const Point<float>& p, VoxelType& voxel) const;
     std::vector< Point<int> > radial_search;
     const float max_dist;
     // Distances are sub-voxel from the precise streamline termination point, so the search order is imperfect.
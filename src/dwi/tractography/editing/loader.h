@@ -27,10 +27,12 @@
 #include <string>
 #include <vector>
 
+#include "bitset.h"
 #include "ptr.h"
 
 #include "dwi/tractography/file.h"
 #include "dwi/tractography/properties.h"
+#include "dwi/tractography/spatial_index.h"
 #include "dwi/tractography/streamline.h"
 
 
@@ -46,11 +48,18 @@ namespace MR {
         {
 
           public:
-            Loader (const std::vector<std::string>& files) :
+            //! if \a index_rois is provided, a SpatialIndex of each input file is used
+            //! to avoid reading those streamlines that cannot intersect its include
+            //! and mask ROIs; these are instead passed on as empty streamlines, so
+            //! that the output is unaffected.
+            Loader (const std::vector<std::string>& files, const Tractography::Properties* index_rois = NULL) :
               file_list (files),
               dummy_properties (),
-              reader (new Tractography::Reader<> (file_list[0], dummy_properties)),
-              file_index (0) { }
+              file_index (0),
+              index_rois (index_rois),
+              candidates (0) { 
+                open();
+              }
 
             bool operator() (Tractography::Streamline<>&);
 
@@ -61,22 +70,70 @@ namespace MR {
             Ptr< Tractography::Reader<> > reader;
             size_t file_index;
 
+            const Tractography::Properties* index_rois;
+            Ptr<Tractography::SpatialIndex> index;
+            BitSet candidates;
+            size_t track_index, reader_index;
+
+            void open ();
+            bool read (Tractography::Streamline<>&);
+
         };
 
 
 
+        void Loader::open ()
+        {
+          dummy_properties.clear();
+          reader = new Tractography::Reader<> (file_list[file_index], dummy_properties);
+          index = NULL;
+          track_index = reader_index = 0;
+          // without any include or mask ROIs, the index cannot exclude any
+          // streamlines, so don't build or load it at all:
+          if (index_rois && (index_rois->include.size() || index_rois->mask.size())) {
+            index = new Tractography::SpatialIndex (file_list[file_index]);
+            index->candidates (index_rois->include, index_rois->mask, candidates);
+            INFO ("spatial index: " + str (candidates.count()) + " of " + str (index->size()) + " streamlines in file \"" 
+                  + file_list[file_index] + "\" may intersect the ROIs");
+          }
+        }
+
+
+
+        bool Loader::read (Tractography::Streamline<>& out)
+        {
+          if (!index)
+            return (*reader) (out);
+
+          if (track_index == index->size())
+            return false;
+
+          if (!candidates[track_index]) {
+            out.index = track_index++;
+            return true;
+          }
+
+          if (reader_index != track_index)
+            reader->seek_position (index->offset (track_index), track_index);
+          if (!(*reader) (out))
+            return false;
+          reader_index = ++track_index;
+          return true;
+        }
+
+
+
         bool Loader::operator() (Tractography::Streamline<>& out)
         {
 
           out.clear();
 
-          if ((*reader) (out))
+          if (read (out))
             return true;
 
           while (++file_index != file_list.size()) {
-            dummy_properties.clear();
-            reader = new Tractography::Reader<> (file_list[file_index], dummy_properties);
-            if ((*reader) (out))
+            open();
+            if (read (out))
               return true;
           }
 
@@ -35,6 +35,7 @@
 #include "dwi/tractography/file_base.h"
 #include "dwi/tractography/properties.h"
 #include "dwi/tractography/streamline.h"
+#include "dwi/tractography/weights.h"
 #include "math/vector.h"
 
 
@@ -59,11 +60,8 @@ namespace MR
             current_index (0) {
               open (file, "tracks", properties);
               App::Options opt = App::get_options ("tck_weights_in");
-              if (opt.size()) {
-                weights_file = new std::ifstream (str(opt[0][0]).c_str(), std::ios_base::in);
-                if (!weights_file->good())
-                  throw Exception ("Unable to open streamlines weights file " + str(opt[0][0]));
-              }
+              if (opt.size())
+                weights = new WeightsReader (opt[0][0]);
             }
 
 
@@ -74,6 +72,15 @@ namespace MR
             if (!in.is_open())
               return false;
 
+            if (compact.active()) {
+              if (compact.decode (in, tck))
+                return next_weight (tck);
+              tck.clear();
+              in.close();
+              check_excess_weights();
+              return false;
+            }
+
             do {
               Point<value_type> p = get_next_point();
               if (std::isinf (p[0])) {
@@ -87,25 +94,8 @@ namespace MR
                 return false;
               }
 
-              if (std::isnan (p[0])) {
-                tck.index = current_index++;
-
-                if (weights_file) {
-
-                  (*weights_file) >> tck.weight;
-                  if (weights_file->fail()) {
-                    WARN ("Streamline weights file contains less entries than .tck file; only read " + str(current_index-1) + " streamlines");
-                    in.close();
-                    tck.clear();
-                    return false;
-                  }
-
-                } else {
-                  tck.weight = 1.0;
-                }
-
-                return true;
-              }
+              if (std::isnan (p[0])) 
+                return next_weight (tck);
 
               tck.push_back (p);
             } while (in.good());
@@ -116,12 +106,103 @@ namespace MR
 
 
 
+
+          //! the file offset of the next track to be read
+          int64_t position () { 
+            return in.is_open() ? int64_t (in.tellg()) : -1; 
+          }
+
+          //! move to the track at file offset \a offset, as previously
+          //! returned by position(), which will be assigned index \a index
+          /*! This cannot be combined with streamline weights. */
+          void seek_position (int64_t offset, size_t index) {
+            if (weights)
+              throw Exception ("random access is not supported in conjunction with streamline weights");
+            if (!in.is_open())
+              in.open (data_file.c_str(), std::ios::in | std::ios::binary);
+            in.clear();
+            in.seekg (offset);
+            current_index = index;
+          }
+
+          //! move to track \a index, so that it is the next track read
+          /*! This is only supported for files in the compact encoding, using
+           * the offset index appended to the file on completion; it cannot
+           * be combined with streamline weights. */
+          void seek (size_t index) {
+            if (!compact.active())
+              throw Exception ("random access is only supported for track files in the compact encoding");
+            if (weights)
+              throw Exception ("random access is not supported in conjunction with streamline weights");
+            if (offsets.empty())
+              load_index();
+            if (index / index_interval >= offsets.size())
+              throw Exception ("track index " + str(index) + " out of range in file \"" + data_file + "\"");
+            if (!in.is_open())
+              in.open (data_file.c_str(), std::ios::in | std::ios::binary);
+            in.clear();
+            in.seekg (offsets[index / index_interval]);
+            for (current_index = index - index % index_interval; current_index < index; ++current_index) {
+              if (!compact.skip (in))
+                throw Exception ("track index " + str(index) + " out of range in file \"" + data_file + "\"");
+            }
+          }
+
+
         protected:
           using __ReaderBase__::in;
           using __ReaderBase__::dtype;
+          using __ReaderBase__::compact;
+          using __ReaderBase__::data_file;
 
           size_t current_index;
-          Ptr<std::ifstream> weights_file;
+          Ptr<WeightsReader> weights;
+          std::vector<int64_t> offsets;
+          size_t index_interval;
+
+          //! assign the index and weight of a newly read track
+          bool next_weight (Streamline<value_type>& tck) {
+            tck.index = current_index++;
+
+            if (weights) {
+
+              if (!(*weights) (tck.weight)) {
+                WARN ("Streamline weights file contains less entries than .tck file; only read " + str(current_index-1) + " streamlines");
+                in.close();
+                tck.clear();
+                return false;
+              }
+
+            } else {
+              tck.weight = 1.0;
+            }
+
+            return true;
+          }
+
+          //! read the offset index from the end of a compact track file
+          void load_index () {
+            std::ifstream file (data_file.c_str(), std::ios::in | std::ios::binary);
+            char magic[4];
+            uint64_t num_entries;
+            uint32_t interval;
+            file.seekg (-int64_t (sizeof (num_entries) + sizeof (interval) + sizeof (magic)), file.end);
+            file.read (reinterpret_cast<char*> (&num_entries), sizeof (num_entries));
+            file.read (reinterpret_cast<char*> (&interval), sizeof (interval));
+            file.read (magic, sizeof (magic));
+            if (!file.good() || memcmp (magic, TRACK_COMPACT_INDEX_MAGIC, sizeof (magic)))
+              throw Exception ("no offset index found in track file \"" + data_file + "\" (file may be incomplete)");
+            index_interval = ByteOrder::LE (interval);
+            num_entries = ByteOrder::LE (num_entries);
+            file.seekg (-int64_t (num_entries * sizeof (uint64_t) + sizeof (num_entries) + sizeof (interval) + sizeof (magic)), file.end);
+            for (size_t n = 0; n < num_entries; ++n) {
+              uint64_t offset;
+              file.read (reinterpret_cast<char*> (&offset), sizeof (offset));
+              offsets.push_back (ByteOrder::LE (offset));
+            }
+            if (!file.good() || !index_interval)
+              throw Exception ("error reading offset index from track file \"" + data_file + "\"");
+          }
 
           //! takes care of byte ordering issues
           Point<value_type> get_next_point ()
@@ -162,11 +243,10 @@ namespace MR
           //! Check that the weights file does not contain excess entries
           void check_excess_weights()
           {
-            if (!weights_file)
+            if (!weights)
               return;
             float temp;
-            (*weights_file) >> temp;
-            if (!weights_file->fail())
+            if ((*weights) (temp))
               WARN ("Streamline weights file contains more entries than .tck file");
           }
 
@@ -207,18 +287,28 @@ namespace MR
 
           //! create a new track file with the specified properties
           WriterUnbuffered (const std::string& file, const Properties& properties) :
-            __WriterBase__<T> (file)
+            __WriterBase__<T> (file),
+            tracks_encoded (0)
         {
           File::OFStream out (name, std::ios::out | std::ios::binary | std::ios::trunc);
 
           const_cast<Properties&> (properties).set_timestamp();
 
+          if (Path::has_suffix (name, ".tcq")) 
+            compact.step = File::Config::get_float ("TrackQuantisationStep", 0.01);
+
           create (out, properties, "tracks");
+          timestamp = properties.find ("timestamp")->second;
           barrier_addr = out.tellp();
 
-          Point<value_type> x;
-          format_point (barrier(), x);
-          out.write (reinterpret_cast<char*> (&x[0]), sizeof (x));
+          if (compact.active()) {
+            out.put (0);
+          }
+          else {
+            Point<value_type> x;
+            format_point (barrier(), x);
+            out.write (reinterpret_cast<char*> (&x[0]), sizeof (x));
+          }
           if (!out.good())
             throw Exception ("error writing tracks file \"" + name + "\": " + strerror (errno));
 
@@ -227,7 +317,13 @@ namespace MR
             set_weights_path (opt[0][0]);
         }
 
-          //virtual ~WriterUnbuffered() { }
+          ~WriterUnbuffered () {
+            if (compact.active()) {
+              if (partial_track.size())
+                WARN ("incomplete final track discarded from compact track file \"" + name + "\"");
+              write_index();
+            }
+          }
 
           //! append track to file
           bool operator() (const Streamline<value_type>& tck) {
@@ -240,8 +336,10 @@ namespace MR
 
               commit (buffer, tck.size()+1);
 
-              if (weights_name.size()) 
-                write_weights (str(tck.weight) + "\n");
+              if (weights) {
+                (*weights) (tck.weight);
+                weights->commit();
+              }
 
               ++count;
             }
@@ -251,17 +349,23 @@ namespace MR
 
 
           //! set the path to the track weights
+          /*! the weights are written in binary format if \a path has the
+           * .tcw suffix, or as text otherwise. */
           void set_weights_path (const std::string& path) {
-            if (weights_name.size())
+            if (weights)
               throw Exception ("Cannot change output streamline weights file path");
-            weights_name = path;
-            App::check_overwrite (name);
-            File::OFStream out (weights_name, std::ios::out | std::ios::binary | std::ios::trunc);
+            weights = new WeightsWriter (path, timestamp);
           }
 
         protected:
-          std::string weights_name;
+          using __WriterBase__<T>::compact;
+
+          Ptr<WeightsWriter> weights;
+          std::string timestamp;
           int64_t barrier_addr;
+          size_t tracks_encoded;
+          std::vector<int64_t> offsets;
+          std::vector< Point<value_type> > partial_track;
 
           //! indicates end of track and start of new track
           Point<value_type> delimiter () const { return Point<value_type> (NAN, NAN, NAN); }
@@ -277,15 +381,6 @@ namespace MR
               dest.set (BE(src[0]), BE(src[1]), BE(src[2]));
           }
 
-          //! write track weights data to file
-          void write_weights (const std::string& contents) {
-            File::OFStream out (weights_name, std::ios::in | std::ios::out | std::ios::binary | std::ios::ate);
-            out << contents;
-            if (!out.good())
-              throw Exception ("error writing streamline weights file \"" + weights_name + "\": " + strerror (errno));
-          }
-
-
           //! write track point data to file
           /*! \note \c buffer needs to be greater than \c num_points by one
            * element to add the barrier. */
@@ -293,17 +388,89 @@ namespace MR
             if (num_points == 0) 
               return;
 
+            File::OFStream out (name, std::ios::in | std::ios::out | std::ios::binary | std::ios::ate);
+            commit (out, data, num_points);
+            update_counts (out);
+          }
+
+          //! write track point data to an already open output stream
+          /*! As above, but without updating the counts in the header; this
+           * allows the same stream to be reused over many calls. */
+          void commit (File::OFStream& out, Point<value_type>* data, size_t num_points) {
+            if (num_points == 0) 
+              return;
+
             int64_t prev_barrier_addr = barrier_addr;
 
+            if (compact.active()) {
+              commit_compact (out, data, num_points);
+              return;
+            }
+
             format_point (barrier(), data[num_points]);
-            File::OFStream out (name, std::ios::in | std::ios::out | std::ios::binary | std::ios::ate);
+            out.seekp (prev_barrier_addr + sizeof(Point<value_type>), out.beg);
             out.write (reinterpret_cast<const char* const> (data+1), sizeof (Point<value_type>) * num_points);
             verify_stream (out);
             barrier_addr = int64_t (out.tellp()) - sizeof(Point<value_type>);
             out.seekp (prev_barrier_addr, out.beg);
             out.write (reinterpret_cast<const char* const> (data), sizeof(Point<value_type>));
             verify_stream (out);
-            update_counts (out);
+          }
+
+
+          //! as commit(), for files in the compact encoding
+          /*! The encoded tracks are written in the same order as for
+           * uncompressed data: the new end-of-data marker is written before
+           * the first byte of the new data overwrites the previous marker, so
+           * that the file remains valid at all times. Since a track can only
+           * be encoded once complete, any points following the last
+           * delimiter in \a data are held back until the next commit. */
+          void commit_compact (File::OFStream& out, const Point<value_type>* data, size_t num_points) {
+            std::vector<uint8_t> bytes;
+            for (size_t n = 0; n < num_points; ++n) {
+              // data have already been byte-swapped for output as floating-point values
+              //   (an involution); undo this to quantise the native values
+              Point<value_type> p;
+              format_point (data[n], p);
+              if (std::isnan (p[0])) {
+                // a zero-length track would be read as the end of the data
+                if (partial_track.empty())
+                  continue;
+                if (!(tracks_encoded++ % TRACK_COMPACT_INDEX_INTERVAL))
+                  offsets.push_back (barrier_addr + bytes.size());
+                compact.encode (&partial_track[0], partial_track.size(), bytes);
+                partial_track.clear();
+              }
+              else 
+                partial_track.push_back (p);
+            }
+            if (bytes.empty())
+              return;
+            bytes.push_back (0);
+
+            out.seekp (barrier_addr + 1, out.beg);
+            out.write (reinterpret_cast<const char*> (&bytes[1]), bytes.size() - 1);
+            verify_stream (out);
+            out.seekp (barrier_addr, out.beg);
+            out.write (reinterpret_cast<const char*> (&bytes[0]), 1);
+            verify_stream (out);
+            barrier_addr += bytes.size() - 1;
+          }
+
+          //! append the offset index after the end of the data
+          void write_index () {
+            File::OFStream out (name, std::ios::in | std::ios::out | std::ios::binary);
+            out.seekp (barrier_addr + 1, out.beg);
+            for (size_t n = 0; n < offsets.size(); ++n) {
+              const uint64_t offset = ByteOrder::LE (uint64_t (offsets[n]));
+              out.write (reinterpret_cast<const char*> (&offset), sizeof (offset));
+            }
+            const uint64_t num_entries = ByteOrder::LE (uint64_t (offsets.size()));
+            const uint32_t interval = ByteOrder::LE (uint32_t (TRACK_COMPACT_INDEX_INTERVAL));
+            out.write (reinterpret_cast<const char*> (&num_entries), sizeof (num_entries));
+            out.write (reinterpret_cast<const char*> (&interval), sizeof (interval));
+            out.write (TRACK_COMPACT_INDEX_MAGIC, 4);
+            verify_stream (out);
           }
 
 
@@ -338,8 +505,7 @@ namespace MR
           using __WriterBase__<T>::total_count;
           using WriterUnbuffered<T>::delimiter;
           using WriterUnbuffered<T>::format_point;
-          using WriterUnbuffered<T>::weights_name;
-          using WriterUnbuffered<T>::write_weights;
+          using WriterUnbuffered<T>::weights;
 
           //! create new RAM-buffered track file with specified properties
           /*! the capacity of the RAM buffer can be specified as a config file
@@ -367,8 +533,8 @@ namespace MR
                 add_point (*i);
               add_point (delimiter());
 
-              if (weights_name.size())
-                weights_buffer += str (tck.weight) + ' ';
+              if (weights)
+                (*weights) (tck.weight);
 
               ++count;
             }
@@ -377,11 +543,38 @@ namespace MR
           }
 
 
+          //! append a block of tracks that are already laid out for output
+          /*! \a data holds \a num_points points, comprising \a num_tracks
+           * non-empty tracks each terminated by a delimiter, already in the
+           * byte order of the output datatype (see format_point()), so that
+           * they can be copied directly into the buffer. \a num_generated is
+           * the corresponding increment to the total_count field (i.e.
+           * including any tracks that were not written). If a weights file is
+           * being written, each of these tracks is assigned unit weight, as
+           * for a Streamline constructed from its points. */
+          void append (const Point<value_type>* data, size_t num_points, size_t num_tracks, size_t num_generated) {
+            while (num_points) {
+              if (buffer_size == buffer_capacity)
+                commit();
+              const size_t n = std::min (num_points, buffer_capacity - buffer_size);
+              std::copy (data, data + n, buffer + buffer_size);
+              buffer_size += n;
+              data += n;
+              num_points -= n;
+            }
+            if (weights) {
+              for (size_t n = 0; n != num_tracks; ++n)
+                (*weights) (1.0);
+            }
+            count += num_tracks;
+            total_count += num_generated;
+          }
+
+
         protected:
           const size_t buffer_capacity;
           Ptr<Point<value_type>,true> buffer;
           size_t buffer_size;
-          std::string weights_buffer;
 
           //! add point to buffer and increment buffer_size accordingly 
           void add_point (const Point<value_type>& p) {
@@ -392,10 +585,8 @@ namespace MR
             WriterUnbuffered<T>::commit (buffer, buffer_size);
             buffer_size = 0;
 
-            if (weights_name.size()) {
-              write_weights (weights_buffer);
-              weights_buffer.clear();
-            }
+            if (weights)
+              weights->commit();
           }
 
 
@@ -33,6 +33,8 @@ namespace MR {
       {
         properties.clear();
         dtype = DataType::Undefined;
+        compact = CompactEncoding();
+        std::string encoding;
 
         const std::string firstline ("mrtrix " + type);
         File::KeyValue kv (file, firstline.c_str());
@@ -52,12 +54,29 @@ namespace MR {
           else if (key == "comment") properties.comments.push_back (kv.value());
           else if (key == "file") data_file = kv.value();
           else if (key == "datatype") dtype = DataType::parse (kv.value());
+          else if (key == "encoding") encoding = lowercase (kv.value());
+          else if (key == "quantisation_step") compact.step = to<float> (kv.value());
+          else if (key == "origin") {
+            std::vector<float> V (parse_floats (kv.value()));
+            if (V.size() != 3)
+              throw Exception ("invalid origin specified in " + type + " file \"" + file + "\"");
+            compact.origin.set (V[0], V[1], V[2]);
+          }
           else properties[key] = kv.value();
         }
 
+        if (encoding.size()) {
+          if (encoding != "compact")
+            throw Exception ("unsupported encoding \"" + encoding + "\" in " + type + " file \"" + file + "\"");
+          if (!compact.active())
+            throw Exception ("missing or invalid quantisation step for compact " + type + " file \"" + file + "\"");
+        }
+        else 
+          compact.step = 0.0;
+
         if (dtype == DataType::Undefined)
           throw Exception ("no datatype specified for tracks file \"" + file + "\"");
-        if (dtype != DataType::Float32LE && dtype != DataType::Float32BE &&
+        if (!compact.active() && dtype != DataType::Float32LE && dtype != DataType::Float32BE &&
             dtype != DataType::Float64LE && dtype != DataType::Float64BE)
           throw Exception ("only supported datatype for tracks file are "
               "Float32LE, Float32BE, Float64LE & Float64BE (in " + type  + " file \"" + file + "\")");
@@ -82,6 +101,7 @@ namespace MR {
         else
           fname = file;
 
+        data_file = fname;
         in.open (fname.c_str(), std::ios::in | std::ios::binary);
         if (!in)
           throw Exception ("error opening " + type  + " data file \"" + fname + "\": " + strerror(errno));
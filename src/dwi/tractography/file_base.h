@@ -31,6 +31,7 @@
 #include "file/key_value.h"
 #include "file/ofstream.h"
 #include "file/path.h"
+#include "dwi/tractography/compact_encoding.h"
 #include "dwi/tractography/properties.h"
 
 
@@ -60,6 +61,8 @@ namespace MR
 
           std::ifstream  in;
           DataType  dtype;
+          CompactEncoding compact;
+          std::string data_file;
       };
 
 
@@ -114,7 +117,14 @@ namespace MR
                 it = properties.roi.begin(); it != properties.roi.end(); ++it)
               out << "roi: " << it->first << " " << it->second << "\n";
 
-            out << "datatype: " << dtype.specifier() << "\n";
+            if (compact.active()) {
+              out << "datatype: " << DataType (DataType::UInt8).specifier() << "\n";
+              out << "encoding: compact\n";
+              out << "quantisation_step: " << str (compact.step) << "\n";
+              out << "origin: " << str (compact.origin[0]) << "," << str (compact.origin[1]) << "," << str (compact.origin[2]) << "\n";
+            }
+            else 
+              out << "datatype: " << dtype.specifier() << "\n";
             int64_t data_offset = int64_t(out.tellp()) + 65;
             data_offset += (4 - (data_offset % 4)) % 4;
             out << "file: . " << data_offset << "\n";
@@ -134,6 +144,7 @@ namespace MR
           std::string name;
           DataType dtype;
           int64_t  count_offset;
+          CompactEncoding compact;
 
 
           void verify_stream (const File::OFStream& out) {
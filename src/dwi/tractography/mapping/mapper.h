@@ -71,6 +71,7 @@ class TrackMapperBase
         transform (info),
         map_zero  (false),
         precise   (false),
+        exact     (false),
         ends_only (false),
         upsampler (1) { }
 
@@ -79,6 +80,7 @@ class TrackMapperBase
         transform    (info),
         map_zero     (false),
         precise      (false),
+        exact        (false),
         ends_only    (false),
         dixel_plugin (new DixelMappingPlugin (dirs)),
         upsampler    (1) { }
@@ -88,6 +90,7 @@ class TrackMapperBase
         transform    (info),
         map_zero     (that.map_zero),
         precise      (that.precise),
+        exact        (that.exact),
         ends_only    (that.ends_only),
         dixel_plugin (that.dixel_plugin),
         tod_plugin   (that.tod_plugin),
@@ -102,6 +105,17 @@ class TrackMapperBase
       if (i && ends_only) throw Exception ("Cannot do precise mapping and endpoint mapping together");
       precise = i;
     }
+    // Exact mapping quantifies the length through each voxel as precise mapping
+    //   does, but by traversing the voxel grid along the straight segments between
+    //   streamline points, and so does not depend on upsampling for accuracy;
+    //   any upsampling still applied then only serves to follow the curvature of the
+    //   streamline more closely. Mappers that do not support exact mapping fall back
+    //   to precise mapping.
+    void set_use_exact_mapping (const bool i) {
+      if (i && ends_only) throw Exception ("Cannot do exact mapping and endpoint mapping together");
+      exact = i;
+      if (i) precise = true;
+    }
     void set_map_ends_only (const bool i) {
       if (i && precise) throw Exception ("Cannot do precise mapping and endpoint mapping together");
       ends_only = i;
@@ -130,7 +144,9 @@ class TrackMapperBase
         return true;
       if (preprocess (in, out) || map_zero) {
         upsampler (in);
-        if (precise)
+        if (exact)
+          voxelise_exact (in, out);
+        else if (precise)
           voxelise_precise (in, out);
         else if (ends_only)
           voxelise_ends (in, out);
@@ -148,6 +164,7 @@ class TrackMapperBase
     Image::Transform transform;
     bool map_zero;
     bool precise;
+    bool exact;
     bool ends_only;
 
     RefPtr<DixelMappingPlugin> dixel_plugin;
@@ -162,9 +179,11 @@ class TrackMapperBase
     //   each streamline to each voxel it traverses
     // Third version is the 'precise' mapping as described in the SIFT paper
     // Fourth method only maps the streamline endpoints
+    // Fifth version is the 'exact' mapping: a DDA traversal of the voxel grid
                           void voxelise         (const Streamline<>&, SetVoxel&) const;
     template <class Cont> void voxelise         (const Streamline<>&, Cont&) const;
     template <class Cont> void voxelise_precise (const Streamline<>&, Cont&) const;
+    template <class Cont> void voxelise_exact   (const Streamline<>&, Cont&) const;
     template <class Cont> void voxelise_ends    (const Streamline<>&, Cont&) const;
 
     virtual bool preprocess  (const Streamline<>& tck, SetVoxelExtras& out) const { out.factor = 1.0; return true; }
@@ -296,6 +315,89 @@ void TrackMapperBase::voxelise_precise (const Streamline<>& tck, Cont& out) cons
 
 
 
+// Amanatides & Woo traversal: for each segment between successive points,
+//   step through the voxels it intersects in order, accumulating the exact
+//   length of the segment within each; a voxel is only added to the set once
+//   the streamline leaves it, with the length-weighted mean tangent within it
+template <class Cont>
+void TrackMapperBase::voxelise_exact (const Streamline<>& tck, Cont& out) const
+{
+  typedef Point<float> PointF;
+
+  if (tck.size() < 2)
+    return;
+
+  Point<int> this_voxel (round (transform.scanner2voxel (tck.front())));
+  float length = 0.0;
+  PointF tangent (0.0, 0.0, 0.0);
+
+  auto add_voxel = [&] () {
+    if (length && tangent.normalise().valid() && check (this_voxel, info))
+      add_to_set (out, this_voxel, tangent, length);
+    length = 0.0;
+    tangent.set (0.0, 0.0, 0.0);
+  };
+
+  PointF start_vox (transform.scanner2voxel (tck.front()));
+  for (size_t p = 1; p != tck.size(); ++p) {
+
+    const PointF end_vox (transform.scanner2voxel (tck[p]));
+    const PointF segment (tck[p] - tck[p-1]);
+    const float segment_length = segment.norm();
+    if (!segment_length)
+      continue;
+    const PointF dir (segment * (1.0 / segment_length));
+    const PointF delta (end_vox - start_vox);
+
+    // Rounding errors may place the start of this segment in a voxel
+    //   adjacent to the one where the previous segment ended
+    Point<int> voxel (round (start_vox));
+    if (voxel != this_voxel) {
+      add_voxel();
+      this_voxel = voxel;
+    }
+
+    int step[3];
+    float t_max[3], t_delta[3];
+    for (size_t axis = 0; axis != 3; ++axis) {
+      if (delta[axis] > 0.0) {
+        step[axis] = 1;
+        t_max[axis] = (voxel[axis] + 0.5 - start_vox[axis]) / delta[axis];
+        t_delta[axis] = 1.0 / delta[axis];
+      } else if (delta[axis] < 0.0) {
+        step[axis] = -1;
+        t_max[axis] = (voxel[axis] - 0.5 - start_vox[axis]) / delta[axis];
+        t_delta[axis] = -1.0 / delta[axis];
+      } else {
+        step[axis] = 0;
+        t_max[axis] = t_delta[axis] = std::numeric_limits<float>::infinity();
+      }
+    }
+
+    float t = 0.0;
+    for (;;) {
+      const size_t axis = (t_max[0] < t_max[1]) ? ((t_max[0] < t_max[2]) ? 0 : 2) : ((t_max[1] < t_max[2]) ? 1 : 2);
+      const float t_next = std::min (t_max[axis], 1.0f);
+      const float l = (t_next - t) * segment_length;
+      length += l;
+      tangent += dir * l;
+      if (t_max[axis] >= 1.0)
+        break;
+      add_voxel();
+      voxel[axis] += step[axis];
+      this_voxel = voxel;
+      t = t_next;
+      t_max[axis] += t_delta[axis];
+    }
+
+    start_vox = end_vox;
+  }
+
+  add_voxel();
+}
+
+
+
 template <class Cont>
 void TrackMapperBase::voxelise_ends (const Streamline<>& tck, Cont& out) const
 {
@@ -30,6 +30,7 @@
 #include "image/buffer.h"
 #include "image/loop.h"
 #include "image/nav.h"
+#include "image/threaded_loop.h"
 #include "image/header.h"
 #include "math/vector.h"
 #include "thread_queue.h"
@@ -41,6 +42,7 @@
 
 
 
+#include <mutex>
 #include <typeinfo>
 
 
@@ -107,6 +109,35 @@ class MapWriterBase
     virtual bool operator() (const Gaussian::SetVoxelTOD&) { return false; }
 
 
+    // Functor for accumulating the mapped streamlines in multiple threads:
+    //   each copy maps into its own private buffer (allocated on first use),
+    //   and hands it back to the writer on destruction; these are then
+    //   reduced into the output image in parallel, before the writer is finalised.
+    // Use in place of the writer itself as the sink of Thread::run_queue(),
+    //   wrapped in Thread::multi()
+    class Shard
+    {
+      public:
+        Shard (MapWriterBase& writer) : writer (writer) { }
+        Shard (const Shard& that) : writer (that.writer) { }
+        ~Shard () { if (local) writer.add_shard (local.release()); }
+
+        template <class Cont>
+        bool operator() (const Cont& in)
+        {
+          if (!local)
+            local = writer.create_shard();
+          return (*local) (in);
+        }
+
+      private:
+        MapWriterBase& writer;
+        Ptr<MapWriterBase> local;
+    };
+
+    Shard shard () { return Shard (*this); }
+
+
   protected:
     Image::Header& H;
     const std::string output_image_name;
@@ -120,6 +151,18 @@ class MapWriterBase
     Ptr<counts_buffer_type> counts;
     Ptr<counts_voxel_type > v_counts;
 
+    // Per-thread buffers returned by Shard functors, awaiting reduction
+    VecPtr<MapWriterBase> shards;
+    std::mutex shard_mutex;
+
+    virtual MapWriterBase* create_shard () { throw Exception ("Per-thread accumulation not supported by this TWI writer"); }
+
+    void add_shard (MapWriterBase* shard)
+    {
+      std::lock_guard<std::mutex> lock (shard_mutex);
+      shards.push_back (shard);
+    }
+
 };
 
 
@@ -140,55 +183,17 @@ class MapWriter : public MapWriterBase
     MapWriter (Image::Header& header, const std::string& name, const vox_stat_t voxel_statistic = V_SUM, const writer_dim type = GREYSCALE) :
         MapWriterBase (header, name, voxel_statistic, type),
         buffer (header, "TWI " + str(writer_dims[type]) + " buffer"),
-        v_buffer (buffer)
+        v_buffer (buffer),
+        is_shard (false)
     {
-      Image::LoopInOrder loop (v_buffer);
-      if (type == DEC || type == TOD) {
-
-        if (voxel_statistic == V_MIN) {
-          for (auto l = loop (v_buffer); l; ++l )
-            v_buffer.value() = std::numeric_limits<value_type>::max();
-        } else {
-          buffer.zero();
-        }
-
-      } else { // Greyscale and dixel
-
-        if (voxel_statistic == V_MIN) {
-          for (auto l = loop (v_buffer); l; ++l )
-            v_buffer.value() = std::numeric_limits<value_type>::max();
-        } else if (voxel_statistic == V_MAX) {
-          for (auto l = loop (v_buffer); l; ++l )
-            v_buffer.value() = std::numeric_limits<value_type>::lowest();
-        } else {
-          buffer.zero();
-        }
-
-      }
-
-      // With TOD, hijack the counts buffer in voxel statistic min/max mode
-      //   (use to store maximum / minimum factors and hence decide when to update the TOD)
-      // No need to track counts for mean voxel-wise statistic in a DEC image;
-      //   can just normalise the DEC to a unit vector
-      if ((type != DEC && voxel_statistic == V_MEAN) ||
-          (type == TOD && (voxel_statistic == V_MIN || voxel_statistic == V_MAX)) ||
-          (type == DEC && voxel_statistic == V_SUM))
-      {
-        Image::Header H_counts (header);
-        if (type == DEC || type == TOD) {
-          H_counts.set_ndim (3);
-          H_counts.sanitise();
-        }
-        counts = new counts_buffer_type (H_counts, "TWI streamline count buffer");
-        counts->zero();
-        v_counts = new counts_voxel_type (*counts);
-      }
+      initialise();
     }
 
     MapWriter (const MapWriter& that) :
         MapWriterBase (that),
         buffer (H, ""),
-        v_buffer (buffer)
+        v_buffer (buffer),
+        is_shard (false)
     {
       throw Exception ("Do not instantiate copy constructor for MapWriter");
     }
@@ -196,6 +201,13 @@ class MapWriter : public MapWriterBase
     ~MapWriter ()
     {
 
+      // Per-thread buffers are only ever reduced into the output buffer
+      if (is_shard)
+        return;
+
+      if (shards.size())
+        merge_shards();
+
       Image::LoopInOrder loop (v_buffer, 0, 3);
       switch (voxel_statistic) {
 
@@ -324,6 +336,24 @@ class MapWriter : public MapWriterBase
   private:
     BufferScratchDump<value_type> buffer;
     buffer_voxel_type v_buffer;
+    const bool is_shard;
+
+    // Construct a private accumulation buffer for a Shard functor
+    MapWriter (Image::Header& header, const vox_stat_t voxel_statistic, const writer_dim type, const bool) :
+        MapWriterBase (header, "", voxel_statistic, type),
+        buffer (header, "TWI " + str(writer_dims[type]) + " per-thread buffer"),
+        v_buffer (buffer),
+        is_shard (true)
+    {
+      initialise();
+    }
+
+    MapWriterBase* create_shard () { return new MapWriter (H, voxel_statistic, type, true); }
+
+    void initialise ();
+    void merge_shards ();
+
+    class ShardMerger;
 
     // Template functions used so that the functors don't have to be written twice
     //   (once for standard TWI and one for Gaussian track-wise statistic)
@@ -362,6 +392,216 @@ class MapWriter : public MapWriterBase
 
 
 
+template <typename value_type>
+void MapWriter<value_type>::initialise ()
+{
+  Image::LoopInOrder loop (v_buffer);
+  if (type == DEC || type == TOD) {
+
+    if (voxel_statistic == V_MIN) {
+      for (auto l = loop (v_buffer); l; ++l )
+        v_buffer.value() = std::numeric_limits<value_type>::max();
+    } else {
+      buffer.zero();
+    }
+
+  } else { // Greyscale and dixel
+
+    if (voxel_statistic == V_MIN) {
+      for (auto l = loop (v_buffer); l; ++l )
+        v_buffer.value() = std::numeric_limits<value_type>::max();
+    } else if (voxel_statistic == V_MAX) {
+      for (auto l = loop (v_buffer); l; ++l )
+        v_buffer.value() = std::numeric_limits<value_type>::lowest();
+    } else {
+      buffer.zero();
+    }
+
+  }
+
+  // With TOD, hijack the counts buffer in voxel statistic min/max mode
+  //   (use to store maximum / minimum factors and hence decide when to update the TOD)
+  // No need to track counts for mean voxel-wise statistic in a DEC image;
+  //   can just normalise the DEC to a unit vector
+  if ((type != DEC && voxel_statistic == V_MEAN) ||
+      (type == TOD && (voxel_statistic == V_MIN || voxel_statistic == V_MAX)) ||
+      (type == DEC && voxel_statistic == V_SUM))
+  {
+    Image::Header H_counts (H);
+    if (type == DEC || type == TOD) {
+      H_counts.set_ndim (3);
+      H_counts.sanitise();
+    }
+    counts = new counts_buffer_type (H_counts, "TWI streamline count buffer");
+    counts->zero();
+    v_counts = new counts_voxel_type (*counts);
+  }
+}
+
+
+
+// Reduces the per-thread buffers into the output buffer for a single voxel,
+//   according to the voxel-wise statistic; the counts buffer is combined
+//   alongside for those statistics that make use of it
+template <typename value_type>
+class MapWriter<value_type>::ShardMerger
+{
+  public:
+    ShardMerger (MapWriter& writer) :
+        type (writer.type),
+        voxel_statistic (writer.voxel_statistic)
+    {
+      for (size_t i = 0; i != writer.shards.size(); ++i) {
+        MapWriter& shard (*static_cast<MapWriter*> (writer.shards[i]));
+        inputs.push_back (shard.v_buffer);
+        if (shard.v_counts)
+          input_counts.push_back (*shard.v_counts);
+      }
+      if (writer.v_counts)
+        output_counts = new counts_voxel_type (*writer.v_counts);
+    }
+
+    ShardMerger (const ShardMerger& that) :
+        type (that.type),
+        voxel_statistic (that.voxel_statistic),
+        inputs (that.inputs),
+        input_counts (that.input_counts),
+        output_counts (that.output_counts ? new counts_voxel_type (*that.output_counts) : NULL) { }
+
+    void operator() (buffer_voxel_type& out)
+    {
+      for (size_t i = 0; i != inputs.size(); ++i)
+        Image::Nav::set_pos (inputs[i], out, 0, 3);
+      if (output_counts) {
+        Image::Nav::set_pos (*output_counts, out, 0, 3);
+        for (size_t i = 0; i != input_counts.size(); ++i)
+          Image::Nav::set_pos (input_counts[i], out, 0, 3);
+      }
+      switch (type) {
+        case GREYSCALE: merge_value (out); break;
+        case DIXEL:
+          for (out[3] = 0; out[3] != out.dim(3); ++out[3])
+            merge_value (out);
+          break;
+        case DEC: merge_dec (out); break;
+        case TOD: merge_tod (out); break;
+        default: assert (0);
+      }
+    }
+
+  private:
+    const writer_dim type;
+    const vox_stat_t voxel_statistic;
+    std::vector<buffer_voxel_type> inputs;
+    std::vector<counts_voxel_type> input_counts;
+    Ptr<counts_voxel_type> output_counts;
+
+    void merge_value (buffer_voxel_type& out)
+    {
+      for (size_t i = 0; i != inputs.size(); ++i) {
+        if (type == DIXEL)
+          inputs[i][3] = out[3];
+        switch (voxel_statistic) {
+          case V_SUM: case V_MEAN: out.value() += inputs[i].value(); break;
+          case V_MIN: out.value() = MIN(out.value(), inputs[i].value()); break;
+          case V_MAX: out.value() = MAX(out.value(), inputs[i].value()); break;
+          default: assert (0);
+        }
+      }
+      if (output_counts) {
+        if (type == DIXEL)
+          (*output_counts)[3] = out[3];
+        for (size_t i = 0; i != input_counts.size(); ++i) {
+          if (type == DIXEL)
+            input_counts[i][3] = out[3];
+          output_counts->value() += input_counts[i].value();
+        }
+      }
+    }
+
+    void merge_dec (buffer_voxel_type& out)
+    {
+      if (voxel_statistic == V_SUM || voxel_statistic == V_MEAN) {
+        for (out[3] = 0; out[3] != 3; ++out[3]) {
+          for (size_t i = 0; i != inputs.size(); ++i) {
+            inputs[i][3] = out[3];
+            out.value() += inputs[i].value();
+          }
+        }
+        if (output_counts) {
+          for (size_t i = 0; i != input_counts.size(); ++i)
+            output_counts->value() += input_counts[i].value();
+        }
+      } else {
+        float norm2 = get_norm2 (out);
+        for (size_t i = 0; i != inputs.size(); ++i) {
+          const float in_norm2 = get_norm2 (inputs[i]);
+          if ((voxel_statistic == V_MIN) ? (in_norm2 < norm2) : (in_norm2 > norm2)) {
+            norm2 = in_norm2;
+            copy_volumes (inputs[i], out);
+          }
+        }
+      }
+    }
+
+    void merge_tod (buffer_voxel_type& out)
+    {
+      if (voxel_statistic == V_SUM || voxel_statistic == V_MEAN) {
+        for (out[3] = 0; out[3] != out.dim(3); ++out[3]) {
+          for (size_t i = 0; i != inputs.size(); ++i) {
+            inputs[i][3] = out[3];
+            out.value() += inputs[i].value();
+          }
+        }
+        if (output_counts) {
+          for (size_t i = 0; i != input_counts.size(); ++i)
+            output_counts->value() += input_counts[i].value();
+        }
+      } else {
+        // Counts buffer holds the min / max factor contributing to each TOD
+        assert (output_counts);
+        for (size_t i = 0; i != inputs.size(); ++i) {
+          const float factor = input_counts[i].value();
+          if ((voxel_statistic == V_MIN) ? (factor < output_counts->value()) : (factor > output_counts->value())) {
+            output_counts->value() = factor;
+            copy_volumes (inputs[i], out);
+          }
+        }
+      }
+    }
+
+    static float get_norm2 (buffer_voxel_type& v)
+    {
+      float norm2 = 0.0;
+      for (v[3] = 0; v[3] != 3; ++v[3])
+        norm2 += Math::pow2 (float (v.value()));
+      return norm2;
+    }
+
+    static void copy_volumes (buffer_voxel_type& in, buffer_voxel_type& out)
+    {
+      for (out[3] = 0; out[3] != out.dim(3); ++out[3]) {
+        in[3] = out[3];
+        out.value() = in.value();
+      }
+    }
+
+};
+
+
+
+template <typename value_type>
+void MapWriter<value_type>::merge_shards ()
+{
+  ShardMerger merger (*this);
+  Image::ThreadedLoop ("merging " + str(shards.size()) + " per-thread buffers...", v_buffer, 0, 3).run (merger, v_buffer);
+  shards.clear();
+}
+
+
+
+
+
 template <typename value_type>
 template <class Cont>
 void MapWriter<value_type>::receive_greyscale (const Cont& in)
@@ -80,6 +80,67 @@ namespace MR {
 
 
 
+      int ROI::contains (const Point<>& lower, const Point<>& upper) const
+      {
+        if (mask) {
+          // range of voxel indices that points within the box may round to,
+          // with a small margin to allow for rounding errors:
+          Point<int> from (std::numeric_limits<int>::max(), std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
+          Point<int> to (std::numeric_limits<int>::min(), std::numeric_limits<int>::min(), std::numeric_limits<int>::min());
+          for (size_t corner = 0; corner != 8; ++corner) {
+            const Point<> s ((corner & 1) ? upper[0] : lower[0], (corner & 2) ? upper[1] : lower[1], (corner & 4) ? upper[2] : lower[2]);
+            const Point<> v (mask->transform.scanner2voxel (s));
+            for (size_t axis = 0; axis != 3; ++axis) {
+              from[axis] = std::min (from[axis], int (std::round (v[axis] - 1.0e-3)));
+              to[axis]   = std::max (to[axis],   int (std::round (v[axis] + 1.0e-3)));
+            }
+          }
+
+          bool any_outside = false;
+          for (size_t axis = 0; axis != 3; ++axis) {
+            if (from[axis] < 0 || to[axis] >= mask->dim(axis))
+              any_outside = true;
+            from[axis] = std::max (from[axis], 0);
+            to[axis] = std::min (to[axis], mask->dim(axis)-1);
+            if (from[axis] > to[axis])
+              return -1;
+          }
+
+          auto vox = mask->voxel();
+          size_t num_inside = 0, num_voxels = 0;
+          for (vox[2] = from[2]; vox[2] <= to[2]; ++vox[2]) {
+            for (vox[1] = from[1]; vox[1] <= to[1]; ++vox[1]) {
+              for (vox[0] = from[0]; vox[0] <= to[0]; ++vox[0]) {
+                ++num_voxels;
+                if (vox.value())
+                  ++num_inside;
+              }
+            }
+          }
+          if (!num_inside)
+            return -1;
+          return (num_inside == num_voxels && !any_outside) ? 1 : 0;
+        }
+
+        // sphere: compare the nearest and furthest points of the box to the
+        // radius, with a small margin to allow for rounding errors
+        float min_dist2 = 0.0, max_dist2 = 0.0;
+        for (size_t axis = 0; axis != 3; ++axis) {
+          const float below = lower[axis] - pos[axis], above = pos[axis] - upper[axis];
+          const float nearest = std::max (0.0f, std::max (below, above));
+          min_dist2 += Math::pow2 (nearest);
+          max_dist2 += std::max (Math::pow2 (below), Math::pow2 (above));
+        }
+        if (max_dist2 < radius2 * (1.0f - 1.0e-4f))
+          return 1;
+        if (min_dist2 > radius2 * (1.0f + 1.0e-4f))
+          return -1;
+        return 0;
+      }
+
+
+
+
       Mask* get_mask (const std::string& name)
       {
         Image::Buffer<bool> data (name);
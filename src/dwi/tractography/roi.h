@@ -114,6 +114,39 @@ namespace MR
 
           }
 
+          //! test whether the axis-aligned box [\a lower, \a upper] lies within the ROI
+          /*! returns 1 if contains() is guaranteed to be true for all points
+           * within the box, -1 if it is guaranteed to be false, and 0
+           * otherwise. */
+          int contains (const Point<>& lower, const Point<>& upper) const;
+
+          //! the size of the smallest feature of the ROI (radius or voxel size)
+          float resolution () const {
+            return mask ? std::min (mask->vox(0), std::min (mask->vox(1), mask->vox(2))) : radius;
+          }
+
+          //! the axis-aligned bounding box of the ROI in scanner space
+          void bounds (Point<>& lower, Point<>& upper) const
+          {
+            if (mask) {
+              lower.set (INFINITY, INFINITY, INFINITY);
+              upper.set (-INFINITY, -INFINITY, -INFINITY);
+              for (size_t corner = 0; corner != 8; ++corner) {
+                const Point<> v ((corner & 1) ? mask->dim(0)-0.5 : -0.5,
+                                 (corner & 2) ? mask->dim(1)-0.5 : -0.5,
+                                 (corner & 4) ? mask->dim(2)-0.5 : -0.5);
+                const Point<> s (mask->transform.voxel2scanner (v));
+                for (size_t axis = 0; axis != 3; ++axis) {
+                  lower[axis] = std::min (lower[axis], s[axis]);
+                  upper[axis] = std::max (upper[axis], s[axis]);
+                }
+              }
+              return;
+            }
+            lower = pos - Point<> (radius, radius, radius);
+            upper = pos + Point<> (radius, radius, radius);
+          }
+
           friend inline std::ostream& operator<< (std::ostream& stream, const ROI& roi)
           {
             stream << roi.shape() << " (" << roi.parameters() << ")";
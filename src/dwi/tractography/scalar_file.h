@@ -26,9 +26,12 @@
 #include <map>
 
 #include "types.h"
+#include "ptr.h"
+#include "get_set.h"
 #include "point.h"
 #include "file/config.h"
 #include "file/key_value.h"
+#include "file/mmap.h"
 #include "file/ofstream.h"
 #include "dwi/tractography/properties.h"
 #include "dwi/tractography/file_base.h"
@@ -152,6 +155,76 @@ namespace MR
 
 
 
+      //! random access to the contents of a track scalar file
+      /*! The data section of the file is memory-mapped, and the location of
+       * the scalars for each streamline is determined in a single pass on
+       * construction. The scalars for any streamline can then be retrieved
+       * directly using load(), without reading through the preceding data. */
+      template <typename T = float> class ScalarIndex : public __ReaderBase__
+      {
+        public:
+          typedef T value_type;
+
+          ScalarIndex (const std::string& file, Properties& properties) {
+            open (file, "track scalars", properties);
+            const int64_t offset = in.tellg();
+            in.seekg (0, in.end);
+            const int64_t end = in.tellg();
+            close();
+
+            offsets.push_back (0);
+            if (end <= offset)
+              return;
+            mmap = new File::MMap (File::Entry (file, offset), false, false);
+            const size_t num_values = mmap->size() / dtype.bytes();
+            for (size_t n = 0; n < num_values; ++n) {
+              const value_type val = get (n);
+              if (std::isinf (val))
+                break;
+              if (std::isnan (val))
+                offsets.push_back (n+1);
+            }
+          }
+
+          //! the number of streamlines in the file
+          size_t size () const { return offsets.size() - 1; }
+
+          //! retrieve the scalars for streamline \a index
+          void load (size_t index, std::vector<value_type>& tck_scalar) const {
+            assert (index < size());
+            tck_scalar.clear();
+            for (size_t n = offsets[index]; n < offsets[index+1] - 1; ++n)
+              tck_scalar.push_back (get (n));
+          }
+
+        protected:
+          using __ReaderBase__::in;
+          using __ReaderBase__::dtype;
+
+          Ptr<File::MMap> mmap;
+          std::vector<size_t> offsets;
+
+          value_type get (size_t index) const
+          {
+            const uint8_t* data = mmap->address();
+            switch (dtype()) {
+              case DataType::Float32LE: return value_type (getLE<float32> (data, index));
+              case DataType::Float32BE: return value_type (getBE<float32> (data, index));
+              case DataType::Float64LE: return value_type (getLE<float64> (data, index));
+              case DataType::Float64BE: return value_type (getBE<float64> (data, index));
+              default:
+                assert (0);
+                break;
+            }
+            return value_type (NAN);
+          }
+
+          ScalarIndex (const ScalarIndex&) = delete;
+
+      };
+
+
+
       //! class to handle writing track scalars to file
       /*! writes track scalar file header as specified in \a properties and individual
        * track scalars to the file specified in \a file. Writing individual scalars is
@@ -0,0 +1,298 @@
+/*
+    Copyright 2014 Brain Research Institute, Melbourne, Australia
+
+    Written by Robert E. Smith, 2014.
+
+    This file is part of MRtrix.
+
+    MRtrix is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    MRtrix is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with MRtrix.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include <map>
+#include <fstream>
+#include <cstdio>
+#include <sys/stat.h>
+
+#include "progressbar.h"
+#include "file/config.h"
+
+#include "dwi/tractography/file.h"
+#include "dwi/tractography/properties.h"
+#include "dwi/tractography/spatial_index.h"
+
+
+#define TRACK_INDEX_MAGIC "mrtrix track index 2"
+#define TRACK_INDEX_BYTE_ORDER 0x01020304U
+
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+
+
+      const char* SpatialIndex::suffix = ".idx";
+
+
+
+      namespace {
+        // st_mtime only has 1 second resolution, which cannot detect a track
+        // file being rewritten shortly after its index was built:
+        int64_t modification_time (const struct stat& sbuf) {
+#if defined(MRTRIX_WINDOWS)
+          return int64_t (sbuf.st_mtime) * 1000000000;
+#elif defined(__APPLE__)
+          return int64_t (sbuf.st_mtimespec.tv_sec) * 1000000000 + sbuf.st_mtimespec.tv_nsec;
+#else
+          return int64_t (sbuf.st_mtim.tv_sec) * 1000000000 + sbuf.st_mtim.tv_nsec;
+#endif
+        }
+      }
+
+
+
+      SpatialIndex::SpatialIndex (const std::string& track_file) :
+        track_file (track_file),
+        index_file (track_file + suffix),
+        cell_size (File::Config::get_float ("TrackIndexCellSize", 8.0)),
+        max_segment_length (0.0)
+      {
+        if (!(cell_size > 0.0))
+          throw Exception ("invalid value for config file entry TrackIndexCellSize");
+
+        struct stat sbuf;
+        if (stat (track_file.c_str(), &sbuf))
+          throw Exception ("cannot stat track file \"" + track_file + "\": " + strerror (errno));
+
+        const int64_t mtime = modification_time (sbuf);
+        if (load (sbuf.st_size, mtime)) {
+          DEBUG ("loaded spatial index for track file \"" + track_file + "\"");
+          return;
+        }
+
+        build();
+        save (sbuf.st_size, mtime);
+      }
+
+
+
+
+      void SpatialIndex::find (const ROI& roi, BitSet& result) const
+      {
+        Point<> lower, upper;
+        roi.bounds (lower, upper);
+        // points interpolated between two stored points (e.g. by tckedit
+        // -upsample) never lie further than one segment length from both:
+        const Point<> margin (max_segment_length, max_segment_length, max_segment_length);
+        lower -= margin;
+        upper += margin;
+        const Point<int> from (cell (lower)), to (cell (upper));
+
+        Point<int> c;
+        for (c[2] = from[2]; c[2] <= to[2]; ++c[2]) {
+          for (c[1] = from[1]; c[1] <= to[1]; ++c[1]) {
+            for (c[0] = from[0]; c[0] <= to[0]; ++c[0]) {
+              const std::vector<uint64_t>::const_iterator k = std::lower_bound (keys.begin(), keys.end(), key (c));
+              if (k == keys.end() || *k != key (c))
+                continue;
+              const size_t n = k - keys.begin();
+              for (size_t i = cell_start[n]; i != cell_start[n+1]; ++i)
+                result[ids[i]] = true;
+            }
+          }
+        }
+      }
+
+
+
+
+      bool SpatialIndex::candidates (const ROISet& include, const ROISet& mask, BitSet& result) const
+      {
+        if (!include.size() && !mask.size())
+          return false;
+
+        result = BitSet (size(), true);
+
+        for (size_t n = 0; n != include.size(); ++n) {
+          BitSet within (size(), false);
+          find (include[n], within);
+          result &= within;
+        }
+
+        if (mask.size()) {
+          BitSet within (size(), false);
+          for (size_t n = 0; n != mask.size(); ++n)
+            find (mask[n], within);
+          result &= within;
+        }
+
+        return true;
+      }
+
+
+
+
+      void SpatialIndex::build ()
+      {
+        Properties properties;
+        Reader<float> reader (track_file, properties);
+        Streamline<float> tck;
+
+        std::map< uint64_t, std::vector<uint32_t> > cells;
+        max_segment_length = 0.0;
+        ProgressBar progress ("building spatial index for track file \"" + shorten (track_file) + "\"...");
+
+        int64_t position = reader.position();
+        while (reader (tck)) {
+          const uint32_t id = offsets.size();
+          offsets.push_back (position);
+          // successive points usually fall within the same cell:
+          uint64_t previous_key = 0;
+          std::vector<uint32_t>* list = NULL;
+          for (size_t n = 0; n != tck.size(); ++n) {
+            if (n)
+              max_segment_length = std::max (max_segment_length, dist (tck[n], tck[n-1]));
+            const uint64_t k = key (cell (tck[n]));
+            if (!list || k != previous_key) {
+              list = &cells[k];
+              previous_key = k;
+              if (list->empty() || list->back() != id)
+                list->push_back (id);
+            }
+          }
+          position = reader.position();
+          ++progress;
+        }
+
+        keys.reserve (cells.size());
+        cell_start.reserve (cells.size() + 1);
+        cell_start.push_back (0);
+        for (std::map< uint64_t, std::vector<uint32_t> >::iterator i = cells.begin(); i != cells.end(); ++i) {
+          keys.push_back (i->first);
+          ids.insert (ids.end(), i->second.begin(), i->second.end());
+          cell_start.push_back (ids.size());
+          std::vector<uint32_t>().swap (i->second);
+        }
+      }
+
+
+
+
+      namespace {
+        template <typename T> 
+          void write_vector (std::ofstream& out, const std::vector<T>& V) {
+            const uint64_t size = V.size();
+            out.write (reinterpret_cast<const char*> (&size), sizeof (size));
+            if (size)
+              out.write (reinterpret_cast<const char*> (&V[0]), size * sizeof (T));
+          }
+
+        template <typename T> 
+          void read_vector (std::ifstream& in, std::vector<T>& V) {
+            uint64_t size = 0;
+            in.read (reinterpret_cast<char*> (&size), sizeof (size));
+            if (!in.good())
+              return;
+            V.resize (size);
+            if (size)
+              in.read (reinterpret_cast<char*> (&V[0]), size * sizeof (T));
+          }
+      }
+
+
+
+      bool SpatialIndex::load (int64_t size, int64_t mtime)
+      {
+        std::ifstream in (index_file.c_str(), std::ios::in | std::ios::binary);
+        if (!in)
+          return false;
+
+        std::string magic;
+        std::getline (in, magic);
+        if (magic != TRACK_INDEX_MAGIC)
+          return false;
+
+        uint32_t byte_order;
+        int64_t stored_size, stored_mtime;
+        float stored_cell_size;
+        in.read (reinterpret_cast<char*> (&byte_order), sizeof (byte_order));
+        in.read (reinterpret_cast<char*> (&stored_size), sizeof (stored_size));
+        in.read (reinterpret_cast<char*> (&stored_mtime), sizeof (stored_mtime));
+        in.read (reinterpret_cast<char*> (&stored_cell_size), sizeof (stored_cell_size));
+        in.read (reinterpret_cast<char*> (&max_segment_length), sizeof (max_segment_length));
+        if (!in.good() || byte_order != TRACK_INDEX_BYTE_ORDER || 
+            stored_size != size || stored_mtime != mtime || stored_cell_size != cell_size) {
+          INFO ("spatial index for track file \"" + track_file + "\" is out of date - rebuilding");
+          return false;
+        }
+
+        read_vector (in, offsets);
+        read_vector (in, keys);
+        read_vector (in, cell_start);
+        read_vector (in, ids);
+        if (!in.good() || cell_start.size() != keys.size() + 1 || cell_start.back() != ids.size()) {
+          WARN ("error reading spatial index for track file \"" + track_file + "\" - rebuilding");
+          offsets.clear(); keys.clear(); cell_start.clear(); ids.clear();
+          return false;
+        }
+        return true;
+      }
+
+
+
+
+      void SpatialIndex::save (int64_t size, int64_t mtime) const
+      {
+        // write to a temporary file and rename, so that concurrent processes never see a partial index
+        const std::string tmp_path (index_file + ".tmp");
+        {
+          std::ofstream out (tmp_path.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+          if (!out) {
+            INFO ("unable to write spatial index file \"" + index_file + "\" - index not saved");
+            return;
+          }
+          const uint32_t byte_order = TRACK_INDEX_BYTE_ORDER;
+          out << TRACK_INDEX_MAGIC << "\n";
+          out.write (reinterpret_cast<const char*> (&byte_order), sizeof (byte_order));
+          out.write (reinterpret_cast<const char*> (&size), sizeof (size));
+          out.write (reinterpret_cast<const char*> (&mtime), sizeof (mtime));
+          out.write (reinterpret_cast<const char*> (&cell_size), sizeof (cell_size));
+          out.write (reinterpret_cast<const char*> (&max_segment_length), sizeof (max_segment_length));
+          write_vector (out, offsets);
+          write_vector (out, keys);
+          write_vector (out, cell_start);
+          write_vector (out, ids);
+          if (!out.good()) {
+            INFO ("error writing spatial index file \"" + index_file + "\" - index not saved");
+            out.close();
+            std::remove (tmp_path.c_str());
+            return;
+          }
+        }
+
+        if (std::rename (tmp_path.c_str(), index_file.c_str())) {
+          INFO ("unable to write spatial index file \"" + index_file + "\" - index not saved");
+          std::remove (tmp_path.c_str());
+        }
+      }
+
+
+
+    }
+  }
+}
+
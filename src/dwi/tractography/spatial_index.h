@@ -0,0 +1,115 @@
+/*
+    Copyright 2014 Brain Research Institute, Melbourne, Australia
+
+    Written by Robert E. Smith, 2014.
+
+    This file is part of MRtrix.
+
+    MRtrix is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    MRtrix is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with MRtrix.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef __dwi_tractography_spatial_index_h__
+#define __dwi_tractography_spatial_index_h__
+
+#include <vector>
+
+#include "bitset.h"
+#include "point.h"
+
+#include "dwi/tractography/roi.h"
+
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+
+
+
+      //! a spatial index of the streamlines in a track file
+      /*! Space is divided into cubic cells (of size given by the
+       * TrackIndexCellSize config file field, in mm; default 8), and the index
+       * records which streamlines have at least one point within each
+       * (non-empty) cell, along with the file offset of each streamline. This
+       * allows the streamlines that cannot possibly intersect a given ROI to
+       * be identified without reading the track file.
+       *
+       * The index also records the longest segment (distance between
+       * successive points) in the file; ROI bounds are expanded by this
+       * amount when searching, so that streamlines whose points straddle an
+       * ROI (or that pass through it once upsampled) are not missed.
+       *
+       * The index is built on first use by reading through the track file
+       * once, and stored alongside it (as \c <file>.idx), keyed on the size
+       * and modification time (to the nanosecond, where the filesystem
+       * supports it) of the track file. It is rebuilt automatically
+       * if the track file changes. If the index cannot be written, it is
+       * simply rebuilt next time. */
+      class SpatialIndex
+      {
+        public:
+          SpatialIndex (const std::string& track_file);
+
+          //! the number of streamlines in the track file
+          size_t size () const { return offsets.size(); }
+
+          //! the file offset of streamline \a index, for use with Reader::seek_position()
+          int64_t offset (size_t index) const { return offsets[index]; }
+
+          //! flag all streamlines that may intersect \a roi
+          /*! i.e. those with at least one point in a cell overlapping the
+           * bounding box of the ROI, expanded by the longest segment length. */
+          void find (const ROI& roi, BitSet& result) const;
+
+          //! flag the streamlines that could be accepted by tckedit
+          /*! A streamline can only be accepted if it may intersect all of the
+           * \a include ROIs, and (if any \a mask ROIs are provided) at least
+           * one of the mask ROIs. Returns false if neither set contains any
+           * ROIs, i.e. if no streamlines can be excluded. */
+          bool candidates (const ROISet& include, const ROISet& mask, BitSet& result) const;
+
+          static const char* suffix;
+
+        private:
+          const std::string track_file, index_file;
+          float cell_size, max_segment_length;
+          // the keys of the non-empty cells, in ascending order; the
+          // streamlines within cell n are ids[cell_start[n]] to ids[cell_start[n+1]-1]
+          std::vector<uint64_t> keys, cell_start;
+          std::vector<uint32_t> ids;
+          std::vector<int64_t> offsets;
+
+          uint64_t key (const Point<int>& cell) const {
+            return (uint64_t (cell[0] + 0x100000) << 42) | (uint64_t (cell[1] + 0x100000) << 21) | uint64_t (cell[2] + 0x100000);
+          }
+          Point<int> cell (const Point<float>& p) const {
+            return Point<int> (std::floor (p[0] / cell_size), std::floor (p[1] / cell_size), std::floor (p[2] / cell_size));
+          }
+
+          void build ();
+          bool load (int64_t size, int64_t mtime);
+          void save (int64_t size, int64_t mtime) const;
+      };
+
+
+
+    }
+  }
+}
+
+#endif
+
@@ -33,6 +33,7 @@
 #include "dwi/tractography/tracking/generated_track.h"
 #include "dwi/tractography/tracking/method.h"
 #include "dwi/tractography/tracking/shared.h"
+#include "dwi/tractography/tracking/track_chunk.h"
 #include "dwi/tractography/tracking/write_kernel.h"
 
 #include "dwi/tractography/mapping/mapper.h"
@@ -69,8 +70,8 @@ namespace MR
 
                 typename Method::Shared shared (diff_path, properties);
                 WriteKernel writer (shared, destination, properties);
-                Exec<Method> tracker (shared);
-                Thread::run_queue (Thread::multi (tracker), GeneratedTrack(), writer);
+                Exec<Method> tracker (shared, writer.output_datatype());
+                Thread::run_queue (Thread::multi (tracker), TrackChunk(), writer);
 
               } else {
 
@@ -127,19 +128,58 @@ namespace MR
 
 
 
-            Exec (const typename Method::Shared& shared) :
+            Exec (const typename Method::Shared& shared, const DataType& output_dtype = DataType::native (DataType::from<value_type>())) :
               S (shared),
               method (shared),
               track_excluded (false),
-              track_included (S.properties.include.size(), false) { }
+              track_included (S.properties.include.size(), false),
+              tracks_since_merge (0),
+              chunk_size (track_chunk_size (S.max_num_tracks)),
+              output_dtype (output_dtype) { }
+
+            ~Exec ()
+            {
+              if (method.profile)
+                S.profiler->merge (*method.profile);
+            }
 
 
             bool operator() (GeneratedTrack& item) {
+              ProfileScope timer (method.profile, PROFILE_TRACKING);
               if (!gen_track (item))
                 return false;
-              if (track_rejected (item))
-                item.clear();
-              S.downsampler (item);
+              {
+                ProfileScope timer (method.profile, PROFILE_REJECTION);
+                if (track_rejected (item))
+                  item.clear();
+              }
+              {
+                ProfileScope timer (method.profile, PROFILE_DOWNSAMPLE);
+                S.downsampler (item);
+              }
+              if (method.profile) {
+                method.profile->add (PROFILE_TRACKS);
+                method.profile->add (PROFILE_POINTS, item.size());
+                if (++tracks_since_merge == PROFILE_MERGE_INTERVAL) {
+                  S.profiler->merge (*method.profile);
+                  tracks_since_merge = 0;
+                }
+              }
+              return true;
+            }
+
+
+            //! generate a chunk of tracks, to be passed to the writer as a single item
+            bool operator() (TrackChunk& chunk) {
+              // points are converted to the output byte order here, in the
+              // tracking threads, so that the writer only copies blocks:
+              chunk.set_datatype (output_dtype);
+              chunk.clear();
+              while (chunk.size() < chunk_size) {
+                if (!(*this) (track))
+                  return chunk.size();
+                chunk.add (track);
+              }
               return true;
             }
 
@@ -150,32 +190,74 @@ namespace MR
             Method method;
             bool track_excluded;
             std::vector<bool> track_included;
+            size_t tracks_since_merge;
+            const size_t chunk_size;
+            const DataType output_dtype;
+            GeneratedTrack track;
+
+
+            void update_included (const Point<value_type>& p)
+            {
+              if (S.roi_map)
+                S.roi_map->get_include (S.roi_map->contains (p), track_included);
+              else
+                S.properties.include.contains (p, track_included);
+            }
+
+
+            void count (const profile_count_t i, const uint64_t n = 1)
+            {
+              if (method.profile)
+                method.profile->add (i, n);
+            }
 
 
             term_t iterate ()
             {
 
-              const term_t method_term = (S.rk4 ? next_rk4() : method.next());
+              term_t method_term;
+              {
+                ProfileScope timer (method.profile, PROFILE_METHOD);
+                method_term = (S.rk4 ? next_rk4() : method.next());
+              }
+              count (PROFILE_STEPS);
 
               if (method_term)
                 return (S.is_act() && method.act().sgm_depth) ? TERM_IN_SGM : method_term;
 
               if (S.is_act()) {
+                ProfileScope timer (method.profile, PROFILE_ACT);
                 const term_t structural_term = method.act().check_structural (method.pos);
                 if (structural_term)
                   return structural_term;
               }
 
-              if (S.properties.mask.size() && !S.properties.mask.contains (method.pos))
-                return EXIT_MASK;
+              ProfileScope roi_timer (method.profile, PROFILE_ROI);
 
-              if (S.properties.exclude.contains (method.pos))
-                return ENTER_EXCLUDE;
+              if (S.roi_map) {
 
-              // If backtracking is not enabled, add streamline to include regions as it is generated
-              // If it is enabled, this check can only be performed after the streamline is completed
-              if (!(S.is_act() && S.act().backtrack()))
-                S.properties.include.contains (method.pos, track_included);
+                const uint32_t inside = S.roi_map->contains (method.pos);
+                if (!S.roi_map->within_mask (inside))
+                  return EXIT_MASK;
+                if (S.roi_map->within_exclude (inside))
+                  return ENTER_EXCLUDE;
+                if (!(S.is_act() && S.act().backtrack()))
+                  S.roi_map->get_include (inside, track_included);
+
+              } else {
+
+                if (S.properties.mask.size() && !S.properties.mask.contains (method.pos))
+                  return EXIT_MASK;
+
+                if (S.properties.exclude.contains (method.pos))
+                  return ENTER_EXCLUDE;
+
+                // If backtracking is not enabled, add streamline to include regions as it is generated
+                // If it is enabled, this check can only be performed after the streamline is completed
+                if (!(S.is_act() && S.act().backtrack()))
+                  S.properties.include.contains (method.pos, track_included);
+
+              }
 
               if (S.stop_on_all_include && traversed_all_include_regions())
                 return TRAVERSE_ALL_INCLUDE;
@@ -194,32 +276,40 @@ namespace MR
 
               bool unidirectional = S.unidirectional;
 
-              if (S.properties.seeds.is_finite()) {
+              {
+                ProfileScope timer (method.profile, PROFILE_SEEDING);
 
-                if (!S.properties.seeds.get_seed (method.pos, method.dir))
-                  return false;
-                if (!method.check_seed() || !method.init()) {
-                  track_excluded = true;
-                  return true;
-                }
+                if (S.properties.seeds.is_finite()) {
 
-              } else {
+                  count (PROFILE_SEED_ATTEMPTS);
+                  if (!S.properties.seeds.get_seed (method.pos, method.dir))
+                    return false;
+                  if (!method.check_seed() || !method.init()) {
+                    track_excluded = true;
+                    return true;
+                  }
+
+                } else {
+
+                  for (size_t num_attempts = 0; num_attempts != MAX_NUM_SEED_ATTEMPTS; ++num_attempts) {
+                    count (PROFILE_SEED_ATTEMPTS);
+                    if (S.properties.seeds.get_seed (method.pos, method.dir) && method.check_seed() && method.init())
+                      break;
+                  }
+                  if (!method.pos.valid()) {
+                    FAIL ("Failed to find suitable seed point after " + str (MAX_NUM_SEED_ATTEMPTS) + " attempts - aborting");
+                    return false;
+                  }
 
-                for (size_t num_attempts = 0; num_attempts != MAX_NUM_SEED_ATTEMPTS; ++num_attempts) {
-                  if (S.properties.seeds.get_seed (method.pos, method.dir) && method.check_seed() && method.init())
-                    break;
-                }
-                if (!method.pos.valid()) {
-                  FAIL ("Failed to find suitable seed point after " + str (MAX_NUM_SEED_ATTEMPTS) + " attempts - aborting");
-                  return false;
                 }
 
+                count (PROFILE_SEEDS_ACCEPTED);
               }
 
               if (S.is_act() && !unidirectional)
                 unidirectional = method.act().seed_is_unidirectional (method.pos, method.dir);
 
-              S.properties.include.contains (method.pos, track_included);
+              update_included (method.pos);
 
               const Point<value_type> seed_dir (method.dir);
               tck.push_back (method.pos);
@@ -392,7 +482,7 @@ namespace MR
 
                 if (S.act().backtrack()) {
                   for (std::vector< Point<float> >::const_iterator i = tck.begin(); i != tck.end(); ++i)
-                    S.properties.include.contains (*i, track_included);
+                    update_included (*i);
                 }
 
               }
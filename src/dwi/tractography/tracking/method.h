@@ -47,6 +47,7 @@ namespace MR
         MethodBase (const SharedBase& shared) :
           pos                (0.0, 0.0, 0.0),
           dir                (0.0, 0.0, 1.0),
+          profile            (shared.is_profiling() ? new ProfileCounters() : NULL),
           S                  (shared),
           values             (shared.source_buffer.dim(3))
         {
@@ -57,6 +58,7 @@ namespace MR
         MethodBase (const MethodBase& that) :
           pos                 (0.0, 0.0, 0.0),
           dir                 (0.0, 0.0, 1.0),
+          profile             (that.S.is_profiling() ? new ProfileCounters() : NULL),
           S                   (that.S),
           rng                 (that.rng),
           values              (that.values.size())
@@ -85,6 +87,8 @@ namespace MR
         template <class InterpolatorType>
         inline bool get_data (InterpolatorType& source, const Point<value_type>& position)
         {
+            ProfileScope timer (profile, PROFILE_INTERPOLATION);
+            if (profile) profile->add (PROFILE_INTERPOLATIONS);
             source.scanner (position);
             if (!source) return (false);
             for (source[3] = 0; source[3] < source.dim(3); ++source[3])
@@ -117,6 +121,9 @@ namespace MR
 
         Point<value_type> pos, dir;
 
+        // Per-thread profiling counters; NULL unless profiling is enabled
+        Ptr<ProfileCounters> profile;
+
 
       private:
         const SharedBase& S;
@@ -0,0 +1,141 @@
+/*
+    Copyright 2014 Brain Research Institute, Melbourne, Australia
+
+    Written by Robert E. Smith, 2014.
+
+    This file is part of MRtrix.
+
+    MRtrix is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    MRtrix is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with MRtrix.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+
+#include "dwi/tractography/tracking/profiler.h"
+
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+      namespace Tracking
+      {
+
+
+        namespace {
+          const char* stage_names[PROFILE_STAGE_COUNT] = {
+            "Tracking threads (total)", "Seeding", "Tracking method", "FOD / image interpolation", "SH evaluation",
+            "ACT tissue checks", "ROI tests", "Streamline rejection tests", "Downsampling", "Writing" };
+          const char* stage_columns[PROFILE_STAGE_COUNT] = {
+            "tracking", "seeding", "method", "interpolation", "sh", "act", "roi", "rejection", "downsample", "write" };
+          const char* count_names[PROFILE_COUNTER_COUNT] = {
+            "Seed attempts", "Seeds accepted", "Tracking steps", "Interpolations", "SH evaluations",
+            "Streamlines generated", "Points generated", "Streamlines written" };
+
+          double seconds (const uint64_t ns) { return 1.0e-9 * ns; }
+        }
+
+
+
+        Profiler::Profiler (const std::string& stats_path) :
+            stats_timer (PROFILE_STATS_INTERVAL),
+            last_time (0.0),
+            last_generated (0),
+            last_selected (0)
+        {
+          if (stats_path.size()) {
+            stats = new File::OFStream (stats_path, std::ios_base::out | std::ios_base::trunc);
+            (*stats) << "#Time,Generated,Selected,Generated_per_s,Selected_per_s";
+            for (size_t i = 0; i != PROFILE_STAGE_COUNT; ++i)
+              (*stats) << "," << stage_columns[i] << "_s";
+            (*stats) << "\n";
+          }
+        }
+
+
+
+        Profiler::~Profiler ()
+        {
+          const double elapsed = timer.elapsed();
+          if (stats) {
+            write_stats_line (elapsed, totals.count[PROFILE_TRACKS], totals.count[PROFILE_WRITTEN]);
+            stats->close();
+          }
+
+          CONSOLE ("tracking profile (wall time " + str (elapsed) + " s):");
+          CONSOLE ("  throughput: " + str (totals.count[PROFILE_TRACKS] / elapsed) + " streamlines/s generated, "
+                   + str (totals.count[PROFILE_WRITTEN] / elapsed) + " streamlines/s selected");
+
+          // Percentages are given relative to the total busy time of the tracking threads, except for the
+          //   writer, which runs in its own thread and is given relative to the wall time
+          const double total = seconds (totals.time[PROFILE_TRACKING]);
+          for (size_t i = 0; i != PROFILE_STAGE_COUNT; ++i) {
+            const double t = seconds (totals.time[i]);
+            const double fraction = (i == PROFILE_WRITE) ? (t / elapsed) : (total ? t / total : 0.0);
+            CONSOLE ("  " + std::string (stage_names[i]) + ": " + str (t) + " s (" + str (100.0 * fraction) + "%)");
+          }
+          for (size_t i = 0; i != PROFILE_COUNTER_COUNT; ++i)
+            CONSOLE ("  " + std::string (count_names[i]) + ": " + str (totals.count[i]));
+          if (totals.count[PROFILE_TRACKS])
+            CONSOLE ("  mean time per streamline: " + str (1.0e6 * total / totals.count[PROFILE_TRACKS]) + " us (summed over threads)");
+          if (totals.count[PROFILE_STEPS])
+            CONSOLE ("  mean time per step: " + str (1.0e9 * seconds (totals.time[PROFILE_METHOD]) / totals.count[PROFILE_STEPS]) + " ns");
+        }
+
+
+
+        void Profiler::merge (ProfileCounters& counters) const
+        {
+          std::lock_guard<std::mutex> lock (mutex);
+          totals += counters;
+          counters.zero();
+        }
+
+
+
+        void Profiler::update (const size_t generated, const size_t selected) const
+        {
+          if (stats && stats_timer)
+            write_stats_line (timer.elapsed(), generated, selected);
+        }
+
+
+
+        void Profiler::write_stats_line (const double time, const size_t generated, const size_t selected) const
+        {
+          ProfileCounters snapshot;
+          {
+            std::lock_guard<std::mutex> lock (mutex);
+            snapshot = totals;
+          }
+          const double interval = time - last_time;
+          (*stats) << str (time) << "," << str (generated) << "," << str (selected) << ","
+                   << str (interval > 0.0 ? (generated - last_generated) / interval : 0.0) << ","
+                   << str (interval > 0.0 ? (selected - last_selected) / interval : 0.0);
+          for (size_t i = 0; i != PROFILE_STAGE_COUNT; ++i)
+            (*stats) << "," << str (seconds (snapshot.time[i]));
+          (*stats) << "\n";
+          stats->flush();
+          last_time = time;
+          last_generated = generated;
+          last_selected = selected;
+        }
+
+
+
+      }
+    }
+  }
+}
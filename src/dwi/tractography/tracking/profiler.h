@@ -0,0 +1,158 @@
+/*
+    Copyright 2014 Brain Research Institute, Melbourne, Australia
+
+    Written by Robert E. Smith, 2014.
+
+    This file is part of MRtrix.
+
+    MRtrix is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    MRtrix is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with MRtrix.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef __dwi_tractography_tracking_profiler_h__
+#define __dwi_tractography_tracking_profiler_h__
+
+#include <chrono>
+#include <mutex>
+#include <string>
+
+#include "ptr.h"
+#include "timer.h"
+#include "file/ofstream.h"
+
+
+// Number of streamlines generated by each tracking thread between merges of its counters into the shared totals
+#define PROFILE_MERGE_INTERVAL 1000
+
+// Interval in seconds between lines written to the -profile_stats file
+#define PROFILE_STATS_INTERVAL 1.0
+
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+      namespace Tracking
+      {
+
+
+        // Stages of streamline generation for which the elapsed time is accumulated
+        // Note that these are nested: PROFILE_METHOD includes PROFILE_INTERPOLATION and PROFILE_SH,
+        //   and all but PROFILE_WRITE are included in PROFILE_TRACKING
+        enum profile_stage_t { PROFILE_TRACKING, PROFILE_SEEDING, PROFILE_METHOD, PROFILE_INTERPOLATION, PROFILE_SH, PROFILE_ACT, PROFILE_ROI, PROFILE_REJECTION, PROFILE_DOWNSAMPLE, PROFILE_WRITE };
+#define PROFILE_STAGE_COUNT 10
+
+        // Events that are counted
+        enum profile_count_t { PROFILE_SEED_ATTEMPTS, PROFILE_SEEDS_ACCEPTED, PROFILE_STEPS, PROFILE_INTERPOLATIONS, PROFILE_SH_EVALUATIONS, PROFILE_TRACKS, PROFILE_POINTS, PROFILE_WRITTEN };
+#define PROFILE_COUNTER_COUNT 8
+
+
+
+        // Per-thread counters & timers; these are only ever accessed by the thread that owns them,
+        //   and are periodically merged into the totals held by the Profiler
+        class ProfileCounters
+        {
+          public:
+            ProfileCounters () { zero(); }
+
+            void zero ()
+            {
+              for (size_t i = 0; i != PROFILE_STAGE_COUNT; ++i)
+                time[i] = 0;
+              for (size_t i = 0; i != PROFILE_COUNTER_COUNT; ++i)
+                count[i] = 0;
+            }
+
+            ProfileCounters& operator+= (const ProfileCounters& that)
+            {
+              for (size_t i = 0; i != PROFILE_STAGE_COUNT; ++i)
+                time[i] += that.time[i];
+              for (size_t i = 0; i != PROFILE_COUNTER_COUNT; ++i)
+                count[i] += that.count[i];
+              return *this;
+            }
+
+            void add (const profile_count_t i, const uint64_t n = 1) { count[i] += n; }
+
+            uint64_t time[PROFILE_STAGE_COUNT]; // nanoseconds
+            uint64_t count[PROFILE_COUNTER_COUNT];
+        };
+
+
+
+        // Adds the time elapsed during its lifetime to the relevant stage;
+        //   does nothing (and does not query the clock) if profiling is not enabled
+        class ProfileScope
+        {
+          public:
+            ProfileScope (ProfileCounters* counters, const profile_stage_t stage) :
+                counters (counters),
+                stage (stage)
+            {
+              if (counters)
+                from = std::chrono::high_resolution_clock::now();
+            }
+
+            ~ProfileScope ()
+            {
+              if (counters)
+                counters->time[stage] += std::chrono::duration_cast<std::chrono::nanoseconds> (std::chrono::high_resolution_clock::now() - from).count();
+            }
+
+          private:
+            ProfileCounters* const counters;
+            const profile_stage_t stage;
+            std::chrono::high_resolution_clock::time_point from;
+        };
+
+
+
+        // Owned by SharedBase when profiling is requested: aggregates the counters from all threads,
+        //   optionally writes a machine-readable throughput line to file at regular intervals,
+        //   and reports the final breakdown upon destruction
+        class Profiler
+        {
+          public:
+            Profiler (const std::string& stats_path);
+            ~Profiler ();
+
+            // Add the contents of a thread's counters to the totals, and reset them
+            void merge (ProfileCounters&) const;
+
+            // Called by the writer thread after each streamline
+            void update (const size_t generated, const size_t selected) const;
+
+          private:
+            mutable std::mutex mutex;
+            mutable ProfileCounters totals;
+            mutable Timer timer;
+
+            Ptr<File::OFStream> stats;
+            mutable IntervalTimer stats_timer;
+            mutable double last_time;
+            mutable size_t last_generated, last_selected;
+
+            void write_stats_line (const double time, const size_t generated, const size_t selected) const;
+        };
+
+
+
+      }
+    }
+  }
+}
+
+#endif
@@ -0,0 +1,129 @@
+/*
+    Copyright 2014 Brain Research Institute, Melbourne, Australia
+
+    Written by Robert E. Smith, 2014.
+
+    This file is part of MRtrix.
+
+    MRtrix is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    MRtrix is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with MRtrix.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#include "dwi/tractography/tracking/roi_map.h"
+
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+      namespace Tracking
+      {
+
+
+
+        bool ROIMap::suitable (const Properties& properties)
+        {
+          const size_t num_rois = properties.mask.size() + properties.exclude.size() + properties.include.size();
+          return num_rois && num_rois <= ROI_MAP_MAX_ROIS;
+        }
+
+
+
+        ROIMap::ROIMap (const Properties& properties) :
+          mask_bits (0),
+          exclude_bits (0),
+          include_shift (properties.mask.size() + properties.exclude.size())
+        {
+          assert (suitable (properties));
+
+          for (size_t n = 0; n != properties.mask.size(); ++n) {
+            mask_bits |= 1U << rois.size();
+            rois.push_back (&properties.mask[n]);
+          }
+          for (size_t n = 0; n != properties.exclude.size(); ++n) {
+            exclude_bits |= 1U << rois.size();
+            rois.push_back (&properties.exclude[n]);
+          }
+          for (size_t n = 0; n != properties.include.size(); ++n)
+            rois.push_back (&properties.include[n]);
+
+          // the map covers the bounding box of all ROIs; outside of it, no ROI
+          // can contain any point:
+          Point<float> lower (INFINITY, INFINITY, INFINITY), upper (-INFINITY, -INFINITY, -INFINITY);
+          for (size_t n = 0; n != rois.size(); ++n) {
+            Point<float> roi_lower, roi_upper;
+            rois[n]->bounds (roi_lower, roi_upper);
+            for (size_t axis = 0; axis != 3; ++axis) {
+              lower[axis] = std::min (lower[axis], roi_lower[axis]);
+              upper[axis] = std::max (upper[axis], roi_upper[axis]);
+            }
+          }
+
+          // cells of half the smallest ROI feature size (the radius for
+          // spheres, the voxel size for masks) mostly fall entirely inside or
+          // outside each ROI; enlarge if necessary to bound memory usage
+          cell_size = INFINITY;
+          for (size_t n = 0; n != rois.size(); ++n)
+            cell_size = std::min (cell_size, 0.5f * rois[n]->resolution());
+          const Point<float> extent (upper - lower);
+          const float volume = extent[0] * extent[1] * extent[2];
+          cell_size = std::max (cell_size, std::cbrt (volume / float (ROI_MAP_MAX_CELLS)));
+          cell_size = std::max (cell_size, 1.0e-3f);
+
+          // pad by one cell on each side:
+          for (;;) {
+            for (size_t axis = 0; axis != 3; ++axis)
+              dim[axis] = std::ceil (extent[axis] / cell_size) + 2;
+            if (size_t(dim[0]) * dim[1] * dim[2] <= 2 * size_t(ROI_MAP_MAX_CELLS))
+              break;
+            cell_size *= 1.25f;
+          }
+          origin = lower - Point<float> (cell_size, cell_size, cell_size);
+
+          INFO ("rasterising " + str (rois.size()) + " ROIs onto " + str(dim[0]) + "x" + str(dim[1]) + "x" + str(dim[2]) 
+              + " grid with cell size " + str (cell_size) + "mm");
+
+          cells.assign (size_t(dim[0]) * dim[1] * dim[2], 0);
+          size_t num_partial = 0;
+          std::vector<uint64_t>::iterator c = cells.begin();
+          for (int z = 0; z != dim[2]; ++z) {
+            for (int y = 0; y != dim[1]; ++y) {
+              for (int x = 0; x != dim[0]; ++x, ++c) {
+                const Point<float> cell_lower (origin[0] + x*cell_size, origin[1] + y*cell_size, origin[2] + z*cell_size);
+                const Point<float> cell_upper (cell_lower + Point<float> (cell_size, cell_size, cell_size));
+                for (size_t n = 0; n != rois.size(); ++n) {
+                  const int result = rois[n]->contains (cell_lower, cell_upper);
+                  if (result > 0)
+                    *c |= uint64_t (1) << n;
+                  else if (!result)
+                    *c |= uint64_t (1) << (n + 32);
+                }
+                if (*c >> 32)
+                  ++num_partial;
+              }
+            }
+          }
+
+          DEBUG (str (num_partial) + " of " + str (cells.size()) + " ROI map cells require exact testing");
+        }
+
+
+
+      }
+    }
+  }
+}
+
@@ -0,0 +1,132 @@
+/*
+    Copyright 2014 Brain Research Institute, Melbourne, Australia
+
+    Written by Robert E. Smith, 2014.
+
+    This file is part of MRtrix.
+
+    MRtrix is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    MRtrix is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with MRtrix.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef __dwi_tractography_tracking_roi_map_h__
+#define __dwi_tractography_tracking_roi_map_h__
+
+
+#include <vector>
+
+#include "point.h"
+
+#include "dwi/tractography/properties.h"
+#include "dwi/tractography/roi.h"
+
+
+// Maximum number of ROIs that can be represented in the map
+#define ROI_MAP_MAX_ROIS 32
+// Maximum number of cells in the map
+#define ROI_MAP_MAX_CELLS (1 << 22)
+
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+      namespace Tracking
+      {
+
+
+
+        //! all tracking ROIs rasterised into a single lookup volume
+        /*! The mask, exclude and include ROIs are each assigned one bit, and
+         * the bounding box of all ROIs is divided into cells; each cell
+         * stores which ROIs contain the entire cell, and which ROIs only
+         * partially overlap it. Testing a point against all ROIs then requires
+         * a single memory read, with exact tests against individual ROIs only
+         * required for those ROIs whose boundary passes through the cell.
+         * Results are therefore identical to those of ROISet::contains(). */
+        class ROIMap
+        {
+          public:
+            ROIMap (const Properties& properties);
+
+            //! whether the ROIs in \a properties can be represented in a map
+            static bool suitable (const Properties& properties);
+
+            //! the set of ROIs that contain \a p, as a bitfield
+            uint32_t contains (const Point<float>& p) const
+            {
+              const uint64_t value = cell (p);
+              uint32_t inside = uint32_t (value);
+              uint32_t partial = uint32_t (value >> 32);
+              while (partial) {
+                const uint32_t bit = partial & (~partial + 1);
+                if (rois[index_of (bit)]->contains (p))
+                  inside |= bit;
+                partial ^= bit;
+              }
+              return inside;
+            }
+
+            //! whether the point is within the mask (true if no mask ROIs are present)
+            bool within_mask (uint32_t inside) const { return !mask_bits || (inside & mask_bits); }
+            //! whether the point is within any of the exclude ROIs
+            bool within_exclude (uint32_t inside) const { return inside & exclude_bits; }
+            //! flag the include ROIs that contain the point
+            void get_include (uint32_t inside, std::vector<bool>& included) const {
+              if (include_shift >= 32)
+                return;
+              inside >>= include_shift;
+              for (size_t n = 0; inside; ++n, inside >>= 1)
+                if (inside & 1U)
+                  included[n] = true;
+            }
+
+          private:
+            std::vector<const ROI*> rois;
+            uint32_t mask_bits, exclude_bits;
+            size_t include_shift;
+
+            Point<float> origin;
+            float cell_size;
+            int dim[3];
+            std::vector<uint64_t> cells;
+
+            uint64_t cell (const Point<float>& p) const {
+              const int x = std::floor ((p[0] - origin[0]) / cell_size);
+              const int y = std::floor ((p[1] - origin[1]) / cell_size);
+              const int z = std::floor ((p[2] - origin[2]) / cell_size);
+              if (x < 0 || y < 0 || z < 0 || x >= dim[0] || y >= dim[1] || z >= dim[2])
+                return 0;
+              return cells[x + dim[0] * (y + dim[1] * size_t(z))];
+            }
+
+            static size_t index_of (uint32_t bit) {
+              size_t n = 0;
+              while (bit >>= 1)
+                ++n;
+              return n;
+            }
+        };
+
+
+
+      }
+    }
+  }
+}
+
+#endif
+
@@ -28,6 +28,7 @@
 #include "image/nav.h"
 
 #include "point.h"
+#include "ptr.h"
 
 #include "image/header.h"
 #include "image/transform.h"
@@ -35,6 +36,8 @@
 #include "dwi/tractography/resample.h"
 #include "dwi/tractography/roi.h"
 #include "dwi/tractography/ACT/shared.h"
+#include "dwi/tractography/tracking/profiler.h"
+#include "dwi/tractography/tracking/roi_map.h"
 #include "dwi/tractography/tracking/types.h"
 
 #define MAX_TRIALS 1000
@@ -128,9 +131,21 @@ namespace MR
                     throw Exception ("Cannot use -stop option if ACT backtracking is enabled");
                 }
 
+                if (ROIMap::suitable (properties))
+                  roi_map = new ROIMap (properties);
+
                 if (properties.find ("downsample_factor") != properties.end())
                   downsampler.set_ratio (to<int> (properties["downsample_factor"]));
 
+                if (properties.find ("profile") != properties.end()) {
+                  DWI::Tractography::Properties::const_iterator stats_path = properties.find ("profile_stats");
+                  profiler = new Profiler (stats_path == properties.end() ? std::string() : stats_path->second);
+                }
+                // profiling is a property of this run only, not of the tracks:
+                // keep it out of the output file header
+                properties.erase ("profile");
+                properties.erase ("profile_stats");
+
                 for (size_t i = 0; i != TERMINATION_REASON_COUNT; ++i)
                   terminations[i] = 0;
                 for (size_t i = 0; i != REJECTION_REASON_COUNT; ++i)
@@ -230,6 +245,13 @@ namespace MR
             bool unidirectional, rk4, stop_on_all_include;
             Downsampler downsampler;
 
+            // Present only if the number of ROIs allows them to be rasterised
+            Ptr<ROIMap> roi_map;
+
+            // Present only if run-time profiling has been requested
+            Ptr<Profiler> profiler;
+            bool is_profiling() const { return profiler; }
+
             // Additional members for ACT
             bool is_act() const { return act_shared_additions; }
             const ACT::ACT_Shared_additions& act() const { return *act_shared_additions; }
@@ -0,0 +1,133 @@
+/*
+    Copyright 2014 Brain Research Institute, Melbourne, Australia
+
+    Written by Robert E. Smith, 2014.
+
+    This file is part of MRtrix.
+
+    MRtrix is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    MRtrix is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with MRtrix.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef __dwi_tractography_tracking_track_chunk_h__
+#define __dwi_tractography_tracking_track_chunk_h__
+
+
+#include <vector>
+
+#include "datatype.h"
+#include "get_set.h"
+#include "point.h"
+#include "thread.h"
+
+#include "dwi/tractography/tracking/generated_track.h"
+#include "dwi/tractography/tracking/types.h"
+
+
+// Upper limit on the number of tracks generated by each thread per chunk
+#define TRACK_CHUNK_MAX_SIZE 256
+
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+      namespace Tracking
+      {
+
+
+
+    //! a block of consecutive tracks generated by a single tracking thread
+    /*! Passing tracks from the tracking threads to the writer one at a time
+     * makes the queue and the writer thread the bottleneck when many threads
+     * generate short streamlines. Instead, each tracking thread fills a chunk
+     * with track points laid out exactly as they will appear in the output
+     * file (in the byte order of the output datatype, each track terminated
+     * by a NaN delimiter), so the writer only needs to copy complete blocks
+     * of data. The per-track entries retain
+     * the information needed to keep the track counts exact, and to produce
+     * the seed output. Tracks that were rejected are recorded with no
+     * points, so that they contribute to the generated count only. */
+    class TrackChunk
+    {
+      public:
+        TrackChunk () :
+          little_endian (DataType::native (DataType::from<value_type>()).is_little_endian()) { }
+
+        class Entry {
+          public:
+            Entry (size_t end, size_t length, size_t seed_index, const Point<value_type>& seed) :
+              end (end), length (length), seed_index (seed_index), seed (seed) { }
+            size_t end, length, seed_index;
+            Point<value_type> seed;
+        };
+
+        //! set the datatype of the output file, to which added points are converted
+        void set_datatype (const DataType& dtype) { little_endian = dtype.is_little_endian(); }
+
+        void clear () { points.clear(); entries.clear(); }
+
+        void add (const GeneratedTrack& tck) {
+          if (tck.size()) {
+            for (size_t n = 0; n != tck.size(); ++n)
+              add_point (tck[n]);
+            add_point (Point<value_type> (NAN, NAN, NAN));
+            entries.push_back (Entry (points.size(), tck.size(), tck.get_seed_index(), tck[tck.get_seed_index()]));
+          }
+          else
+            entries.push_back (Entry (points.size(), 0, 0, Point<value_type>()));
+        }
+
+        size_t size () const { return entries.size(); }
+        const Entry& operator[] (size_t n) const { return entries[n]; }
+
+        //! the points (including delimiters) for the first \a num_tracks tracks
+        const Point<value_type>* data () const { return points.size() ? &points[0] : NULL; }
+        size_t num_points (size_t num_tracks) const { return num_tracks ? entries[num_tracks-1].end : 0; }
+
+      private:
+        bool little_endian;
+        std::vector< Point<value_type> > points;
+        std::vector<Entry> entries;
+
+        void add_point (const Point<value_type>& p) {
+          using namespace ByteOrder;
+          if (little_endian)
+            points.push_back (Point<value_type> (LE(p[0]), LE(p[1]), LE(p[2])));
+          else
+            points.push_back (Point<value_type> (BE(p[0]), BE(p[1]), BE(p[2])));
+        }
+    };
+
+
+
+    //! the number of tracks to generate per chunk
+    /*! Small enough that the total number of tracks generated in excess of
+     * the requested number remains a small fraction of it. */
+    inline size_t track_chunk_size (size_t max_num_tracks)
+    {
+      return std::max (size_t(1), std::min (size_t(TRACK_CHUNK_MAX_SIZE), max_num_tracks / (16 * Thread::number_of_threads())));
+    }
+
+
+
+      }
+    }
+  }
+}
+
+#endif
+
@@ -86,7 +86,14 @@ namespace MR
       + Option ("stop", "stop propagating a streamline once it has traversed all include regions")
 
       + Option ("downsample", "downsample the generated streamlines to reduce output file size")
-          + Argument ("factor").type_integer (1, 1, 100);
+          + Argument ("factor").type_integer (1, 1, 100)
+
+      + Option ("profile", "upon completion, report the throughput and a breakdown of the time spent in each stage "
+                           "of streamline generation (incurs a small run-time overhead)")
+
+      + Option ("profile_stats", "write a machine-readable line containing the tracking throughput and the cumulative "
+                                 "time spent in each stage to a CSV file at regular intervals (implies -profile)")
+          + Argument ("path").type_file_out();
 
 
 
@@ -166,6 +173,15 @@ namespace MR
         opt = get_options ("downsample");
         if (opt.size()) properties["downsample_factor"] = std::string (opt[0][0]);
 
+        opt = get_options ("profile");
+        if (opt.size()) properties["profile"] = "1";
+
+        opt = get_options ("profile_stats");
+        if (opt.size()) {
+          properties["profile"] = "1";
+          properties["profile_stats"] = std::string (opt[0][0]);
+        }
+
       }
 
 
@@ -38,16 +38,47 @@ namespace MR
           {
             if (complete())
               return false;
-            if (tck.size() && seeds) {
-              const Point<float>& p = tck[tck.get_seed_index()];
-              (*seeds) << str(writer.count) << "," << str(tck.get_seed_index()) << "," << str(p[0]) << "," << str(p[1]) << "," << str(p[2]) << ",\n";
-            }
+            ProfileScope profile_timer (profile, PROFILE_WRITE);
+            if (tck.size() && seeds)
+              write_seed (writer.count, tck.get_seed_index(), tck[tck.get_seed_index()]);
             writer (tck);
-            if (timer && App::log_level > 0) {
-              fprintf (stderr, "\33[2K\r%8zu generated, %8zu selected    [%3u%%]",
-                  writer.total_count, writer.count,
-                  (unsigned int)(100.0 * std::max (writer.total_count/float(S.max_num_attempts), writer.count/float(S.max_num_tracks))));
+            if (profile) {
+              if (tck.size())
+                profile->add (PROFILE_WRITTEN);
+              S.profiler->update (writer.total_count, writer.count);
+            }
+            show_progress();
+            return true;
+          }
+
+
+
+          bool WriteKernel::operator() (const TrackChunk& chunk)
+          {
+            if (complete())
+              return false;
+            ProfileScope profile_timer (profile, PROFILE_WRITE);
+            // only accept as many tracks from this chunk as the -number /
+            // -maxnum limits allow, exactly as if they had been written
+            // individually:
+            size_t selected = writer.count, generated = writer.total_count, n = 0;
+            for (; n < chunk.size(); ++n) {
+              if (selected >= S.max_num_tracks || generated >= S.max_num_attempts)
+                break;
+              if (chunk[n].length) {
+                if (seeds)
+                  write_seed (selected, chunk[n].seed_index, chunk[n].seed);
+                ++selected;
+              }
+              ++generated;
+            }
+            const size_t num_written = selected - writer.count;
+            writer.append (chunk.data(), chunk.num_points (n), num_written, generated - writer.total_count);
+            if (profile) {
+              profile->add (PROFILE_WRITTEN, num_written);
+              S.profiler->update (writer.total_count, writer.count);
             }
+            show_progress();
             return true;
           }
 
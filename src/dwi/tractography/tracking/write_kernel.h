@@ -35,7 +35,9 @@
 #include "dwi/tractography/streamline.h"
 
 #include "dwi/tractography/tracking/generated_track.h"
+#include "dwi/tractography/tracking/profiler.h"
 #include "dwi/tractography/tracking/shared.h"
+#include "dwi/tractography/tracking/track_chunk.h"
 #include "dwi/tractography/tracking/types.h"
 
 
@@ -58,7 +60,8 @@ namespace MR
               const std::string& output_file,
               const DWI::Tractography::Properties& properties) :
                 S (shared),
-                writer (output_file, properties)
+                writer (output_file, properties),
+                profile (shared.is_profiling() ? new ProfileCounters() : NULL)
           {
             DWI::Tractography::Properties::const_iterator seed_output = properties.find ("seed_output");
             if (seed_output != properties.end()) {
@@ -75,11 +78,17 @@ namespace MR
               (*seeds) << "\n";
               seeds->close();
             }
+            if (profile)
+              S.profiler->merge (*profile);
 
           }
 
 
           bool operator() (const GeneratedTrack&);
+          bool operator() (const TrackChunk&);
+
+          //! the datatype (including byte order) of the track data in the output file
+          const DataType& output_datatype () const { return writer.dtype; }
 
           bool complete() const { return (writer.count >= S.max_num_tracks || writer.total_count >= S.max_num_attempts); }
 
@@ -89,6 +98,19 @@ namespace MR
           Writer<value_type> writer;
           Ptr<File::OFStream> seeds;
           IntervalTimer timer;
+          Ptr<ProfileCounters> profile;
+
+          void write_seed (size_t track_index, size_t seed_index, const Point<float>& p) {
+            (*seeds) << str(track_index) << "," << str(seed_index) << "," << str(p[0]) << "," << str(p[1]) << "," << str(p[2]) << ",\n";
+          }
+
+          void show_progress () {
+            if (timer && App::log_level > 0) {
+              fprintf (stderr, "\33[2K\r%8zu generated, %8zu selected    [%3u%%]",
+                  writer.total_count, writer.count,
+                  (unsigned int)(100.0 * std::max (writer.total_count/float(S.max_num_attempts), writer.count/float(S.max_num_tracks))));
+            }
+          }
 
       };
 
@@ -1,4 +1,5 @@
 #include "dwi/tractography/weights.h"
+#include "dwi/tractography/file_base.h"
 
 namespace MR
 {
@@ -10,15 +11,139 @@ namespace MR
       using namespace App;
 
       const Option TrackWeightsInOption
-      = Option ("tck_weights_in", "specify a text scalar file containing the streamline weights")
+      = Option ("tck_weights_in", "specify a file containing the streamline weights, either as text or in binary (.tcw) format")
           + Argument ("path").type_file_in();
 
       const Option TrackWeightsOutOption
-      = Option ("tck_weights_out", "specify the path for an output text scalar file containing streamline weights")
+      = Option ("tck_weights_out", "specify the path for an output file containing streamline weights; "
+          "these will be written in binary format if the path has the .tcw suffix, or as text otherwise")
           + Argument ("path").type_file_out();
 
+
+
+      namespace {
+        // the header of a binary weights file is parsed in the same way as
+        // that of a track or track scalar file
+        class WeightsHeader : public __ReaderBase__
+        {
+          public:
+            WeightsHeader (const std::string& path) {
+              Properties properties;
+              open (path, "track weights", properties);
+              offset = in.tellg();
+              close();
+              count = properties.find ("count") == properties.end() ? 0 : to<size_t> (properties["count"]);
+            }
+            DataType type () const { return dtype; }
+            int64_t offset;
+            size_t count;
+        };
+      }
+
+
+
+      WeightsReader::WeightsReader (const std::string& path) :
+        path (path),
+        num (0),
+        next (0)
+      {
+        // only peek at the start of the file: legacy text weights files may
+        // consist of a single (very long) line
+        const std::string binary_id ("mrtrix track weights");
+        text = new std::ifstream (path.c_str(), std::ios_base::in);
+        if (!text->good())
+          throw Exception ("Unable to open streamlines weights file " + path);
+        std::string magic (binary_id.size(), '\0');
+        text->read (&magic[0], magic.size());
+        if (!text->good() || magic != binary_id) {
+          text->clear();
+          text->seekg (0);
+          return;
+        }
+        text = NULL;
+
+        WeightsHeader H (path);
+        dtype = H.type();
+        num = H.count;
+        if (num) 
+          mmap = new File::MMap (File::Entry (path, H.offset), false, false, num * dtype.bytes());
+      }
+
+
+
+
+      WeightsWriter::WeightsWriter (const std::string& path, const std::string& timestamp) :
+        path (path),
+        binary (is_binary_weights_path (path)),
+        count (0),
+        count_offset (0),
+        data_offset (0)
+      {
+        App::check_overwrite (path);
+        File::OFStream out (path, std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!binary)
+          return;
+
+        DataType dtype (DataType::Float32);
+        dtype.set_byte_order_native();
+        out << "mrtrix track weights\nEND\n";
+        if (timestamp.size())
+          out << "timestamp: " << timestamp << "\n";
+        out << "datatype: " << dtype.specifier() << "\n";
+        data_offset = int64_t(out.tellp()) + 65;
+        data_offset += (4 - (data_offset % 4)) % 4;
+        out << "file: . " << data_offset << "\n";
+        out << "count: ";
+        count_offset = out.tellp();
+        out << "0\nEND\n";
+        out.seekp (0);
+        out << "mrtrix track weights    ";
+        if (!out.good())
+          throw Exception ("error writing streamline weights file \"" + path + "\": " + strerror (errno));
+      }
+
+
+
+      WeightsWriter::~WeightsWriter ()
+      {
+        commit();
+      }
+
+
+
+      void WeightsWriter::commit ()
+      {
+        if (binary) {
+          if (binary_buffer.empty())
+            return;
+          File::OFStream out (path, std::ios::in | std::ios::out | std::ios::binary);
+          out.seekp (data_offset + count * sizeof (float));
+          out.write (reinterpret_cast<const char*> (&binary_buffer[0]), binary_buffer.size() * sizeof (float));
+          count += binary_buffer.size();
+          std::vector<float>().swap (binary_buffer);
+          update_count (out);
+        }
+        else {
+          if (text_buffer.empty())
+            return;
+          File::OFStream out (path, std::ios::in | std::ios::out | std::ios::binary | std::ios::ate);
+          out << text_buffer;
+          std::string().swap (text_buffer);
+          if (!out.good())
+            throw Exception ("error writing streamline weights file \"" + path + "\": " + strerror (errno));
+        }
+      }
+
+
+
+      void WeightsWriter::update_count (File::OFStream& out)
+      {
+        out.seekp (count_offset);
+        out << count << "\nEND\n";
+        if (!out.good())
+          throw Exception ("error writing streamline weights file \"" + path + "\": " + strerror (errno));
+      }
+
     }
   }
 }
-
-
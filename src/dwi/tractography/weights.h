@@ -23,8 +23,16 @@
 #ifndef __dwi_tractography_weights_h__
 #define __dwi_tractography_weights_h__
 
+#include <fstream>
+
 #include "app.h"
 #include "point.h"
+#include "ptr.h"
+#include "datatype.h"
+#include "get_set.h"
+#include "file/mmap.h"
+#include "file/ofstream.h"
+#include "file/path.h"
 
 namespace MR
 {
@@ -37,6 +45,112 @@ namespace MR
       extern const App::Option TrackWeightsInOption;
       extern const App::Option TrackWeightsOutOption;
 
+
+
+      // Streamline weights can be stored either as a text file (one value per
+      // streamline, whitespace-separated), or in a binary format: a standard
+      // MRtrix key-value header ("mrtrix track weights"), followed by one
+      // floating-point value per streamline. The binary format is selected on
+      // output by the .tcw suffix; on input, the format is detected from the
+      // file contents.
+
+      inline bool is_binary_weights_path (const std::string& path) {
+        return Path::has_suffix (path, ".tcw");
+      }
+
+
+
+      //! read streamline weights from either text or binary file
+      /*! Weights can always be read sequentially using operator(). Binary
+       * files are memory-mapped, in which case the weight for any streamline
+       * can also be accessed directly using operator[]. */
+      class WeightsReader
+      {
+        public:
+          WeightsReader (const std::string& path);
+
+          //! whether random access is supported (binary files only)
+          bool is_indexed () const { return !text; }
+          //! the number of weights in the file (binary files only)
+          size_t size () const { assert (is_indexed()); return num; }
+
+          //! the weight for streamline \a index (binary files only)
+          float operator[] (size_t index) const {
+            assert (is_indexed());
+            assert (index < num);
+            const uint8_t* data = mmap->address();
+            switch (dtype()) {
+              case DataType::Float32LE: return getLE<float32> (data, index);
+              case DataType::Float32BE: return getBE<float32> (data, index);
+              case DataType::Float64LE: return getLE<float64> (data, index);
+              case DataType::Float64BE: return getBE<float64> (data, index);
+              default: assert (0);
+            }
+            return NAN;
+          }
+
+          //! fetch the next weight; returns false once all weights have been read
+          bool operator() (float& weight) {
+            if (text) {
+              (*text) >> weight;
+              return !text->fail();
+            }
+            if (next >= num)
+              return false;
+            weight = (*this)[next++];
+            return true;
+          }
+
+        private:
+          const std::string path;
+          Ptr<std::ifstream> text;
+          Ptr<File::MMap> mmap;
+          DataType dtype;
+          size_t num, next;
+      };
+
+
+
+      //! write streamline weights to either text or binary file
+      /*! Weights are held in a RAM buffer until commit() is called (or the
+       * writer is destroyed). For binary output, the count field in the header
+       * is updated on every commit. The \a timestamp should be that of the
+       * corresponding track file. */
+      class WeightsWriter
+      {
+        public:
+          WeightsWriter (const std::string& path, const std::string& timestamp);
+          ~WeightsWriter ();
+
+          void operator() (float weight) {
+            if (binary)
+              binary_buffer.push_back (weight);
+            else 
+              text_buffer += str (weight) + "\n";
+          }
+
+          void commit ();
+
+          const std::string& name () const { return path; }
+
+          //! the memory currently allocated to buffered weights, in bytes
+          size_t buffer_bytes () const {
+            if (binary)
+              return binary_buffer.capacity() * sizeof (float);
+            return text_buffer.empty() ? 0 : text_buffer.capacity();
+          }
+
+        private:
+          const std::string path;
+          const bool binary;
+          std::string text_buffer;
+          std::vector<float> binary_buffer;
+          size_t count;
+          int64_t count_offset, data_offset;
+
+          void update_count (File::OFStream& out);
+      };
+
     }
   }
 }
@@ -0,0 +1,235 @@
+/*
+    Copyright 2014 Brain Research Institute, Melbourne, Australia
+
+    Written by Robert E. Smith, 2014.
+
+    This file is part of MRtrix.
+
+    MRtrix is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    MRtrix is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with MRtrix.  If not, see <http://www.gnu.org/licenses/>.
+
+ */
+
+#ifndef __dwi_tractography_writer_pool_h__
+#define __dwi_tractography_writer_pool_h__
+
+#include <algorithm>
+#include <vector>
+
+#include "ptr.h"
+#include "file/config.h"
+#include "file/ofstream.h"
+#include "dwi/tractography/file.h"
+#include "dwi/tractography/properties.h"
+#include "dwi/tractography/streamline.h"
+
+
+namespace MR
+{
+  namespace DWI
+  {
+    namespace Tractography
+    {
+
+
+
+      //! write tracks to a large number of output files efficiently
+      /*! When tracks need to be distributed across many output files (e.g. one
+       * per edge of a connectome), WriterUnbuffered avoids exhausting the
+       * available file handles by re-opening the relevant file for every
+       * streamline, whereas Writer holds a 16MB RAM buffer per file. This
+       * class instead holds a separate RAM buffer for each output, with a
+       * single memory budget shared across all outputs (including any
+       * buffered streamline weights): when the memory allocated to these
+       * buffers exceeds this budget, the buffers of the least recently used outputs are
+       * flushed to file. A bounded number of output file handles is kept
+       * open between flushes, again evicted in LRU order. The count fields in
+       * the track file headers are only updated when the pool is closed.
+       *
+       * The total buffer size defaults to 64MB, and can be set in the config
+       * file using the TrackWriterPoolBufferSize field (in bytes); the number
+       * of file handles kept open defaults to 64, and can be set using the
+       * TrackWriterPoolOpenFiles field. */
+      template <typename T = float>
+        class WriterPool
+      {
+        public:
+          typedef T value_type;
+
+          WriterPool (const Properties& properties) :
+            properties (properties),
+            buffer_capacity (File::Config::get_int ("TrackWriterPoolBufferSize", 67108864)),
+            max_open (std::max (1, File::Config::get_int ("TrackWriterPoolOpenFiles", 64))),
+            buffer_size (0),
+            num_open (0),
+            clock (0) { }
+
+          ~WriterPool () {
+            close();
+          }
+
+          //! add a new output file, returning its index within the pool
+          size_t add (const std::string& path, const std::string& weights_path = "") {
+            outputs.push_back (new Output (path, properties));
+            if (weights_path.size())
+              outputs.back()->set_weights_path (weights_path);
+            return outputs.size() - 1;
+          }
+
+          size_t size () const { return outputs.size(); }
+
+          //! append a track to output \a index
+          /*! As with the other track writers, an empty track only increments
+           * the total_count field of that output. */
+          void operator() (size_t index, const Streamline<value_type>& tck) {
+            assert (index < outputs.size());
+            Output& output (*outputs[index]);
+            output.last_used = ++clock;
+            buffer_size -= output.buffer_bytes();
+            output.append (tck);
+            buffer_size += output.buffer_bytes();
+            if (buffer_size > buffer_capacity)
+              flush_lru();
+          }
+
+          //! flush all buffered data, update the file headers, and close all outputs
+          void close () {
+            for (size_t n = 0; n < outputs.size(); ++n)
+              flush (n);
+            for (size_t n = 0; n < outputs.size(); ++n) {
+              delete outputs[n];
+              outputs[n] = NULL;
+            }
+            outputs.clear();
+            num_open = 0;
+          }
+
+
+        protected:
+
+          class Output : public WriterUnbuffered<value_type>
+          {
+            public:
+              using __WriterBase__<value_type>::count;
+              using __WriterBase__<value_type>::total_count;
+              using __WriterBase__<value_type>::name;
+              using WriterUnbuffered<value_type>::weights;
+              using WriterUnbuffered<value_type>::format_point;
+              using WriterUnbuffered<value_type>::delimiter;
+
+              Output (const std::string& path, const Properties& properties) :
+                WriterUnbuffered<value_type> (path, properties),
+                last_used (0) { }
+
+              void append (const Streamline<value_type>& tck) {
+                if (tck.size()) {
+                  for (size_t n = 0; n < tck.size(); ++n)
+                    add_point (tck[n]);
+                  add_point (delimiter());
+                  if (weights)
+                    (*weights) (tck.weight);
+                  ++count;
+                }
+                ++total_count;
+              }
+
+              void commit () {
+                if (buffer.empty())
+                  return;
+                assert (stream);
+                // room for the barrier:
+                buffer.push_back (Point<value_type>());
+                WriterUnbuffered<value_type>::commit (*stream, &buffer[0], buffer.size()-1);
+                // release the storage, so that idle outputs do not hold on to their peak allocation:
+                std::vector< Point<value_type> >().swap (buffer);
+                if (weights)
+                  weights->commit();
+              }
+
+              //! the memory currently allocated to this output's buffers, in bytes
+              size_t buffer_bytes () const {
+                return buffer.capacity() * sizeof (Point<value_type>) + (weights ? weights->buffer_bytes() : 0);
+              }
+
+              void open () {
+                stream = new File::OFStream (name, std::ios::in | std::ios::out | std::ios::binary);
+              }
+
+              std::vector< Point<value_type> > buffer;
+              Ptr<File::OFStream> stream;
+              size_t last_used;
+
+            private:
+              void add_point (const Point<value_type>& p) {
+                buffer.push_back (Point<value_type>());
+                format_point (p, buffer.back());
+              }
+          };
+
+
+          Properties properties;
+          std::vector<Output*> outputs;
+          const size_t buffer_capacity, max_open;
+          size_t buffer_size, num_open, clock;
+
+
+          //! write the contents of the buffer for output \a index to file
+          void flush (size_t index) {
+            Output& output (*outputs[index]);
+            if (output.buffer.empty())
+              return;
+            if (!output.stream) {
+              if (num_open >= max_open)
+                close_lru_stream();
+              output.open();
+              ++num_open;
+            }
+            buffer_size -= output.buffer_bytes();
+            output.commit();
+            buffer_size += output.buffer_bytes();
+          }
+
+          //! flush the least recently used outputs until half the buffer capacity is free
+          void flush_lru () {
+            std::vector< std::pair<size_t,size_t> > candidates;
+            for (size_t n = 0; n < outputs.size(); ++n)
+              if (outputs[n]->buffer.size())
+                candidates.push_back (std::make_pair (outputs[n]->last_used, n));
+            std::sort (candidates.begin(), candidates.end());
+            for (size_t n = 0; n < candidates.size() && buffer_size > buffer_capacity / 2; ++n)
+              flush (candidates[n].second);
+          }
+
+          void close_lru_stream () {
+            Output* lru = NULL;
+            for (size_t n = 0; n < outputs.size(); ++n)
+              if (outputs[n]->stream && (!lru || outputs[n]->last_used < lru->last_used))
+                lru = outputs[n];
+            assert (lru);
+            lru->stream = NULL;
+            --num_open;
+          }
+
+
+          WriterPool (const WriterPool&) = delete;
+      };
+
+
+
+    }
+  }
+}
+
+
+#endif
+